@@ -27,24 +27,20 @@ SOFTWARE.
 #include "Renderer.h"
 #include "ObjData.h"
 #include "vector_math.h"
-#include <algorithm>
 
 typedef vmath::vec3<float> vec3f;
 typedef vmath::vec4<float> vec4f;
 typedef vmath::mat4<float> mat4f;
 
 static SDL_Surface* surface;
-static SDL_Surface* texture;
+static Texture* texture;
 
 static void drawPixel(const PixelData *p)
 {
-	int tx = std::max(0, int(p->pvar[0] * 255)) % 255;
-	int ty = std::max(0, int(p->pvar[1] * 255)) % 255;
-
-	Uint32 *texBuffer = (Uint32*)((Uint8 *)texture->pixels + (int)ty * texture->pitch + (int)tx * 4);
 	Uint32 *screenBuffer = (Uint32*)((Uint8 *)surface->pixels + (int)p->y * surface->pitch + (int)p->x * 4);
 
-    *screenBuffer = *texBuffer;
+    float lod = Texture_pixelLod(texture, p, 0, 1);
+    *screenBuffer = Texture_sample(texture, TF_Trilinear, p->pvar[0], p->pvar[1], lod);
 }
 
 static mat4f modelViewProjectionMatrix;
@@ -78,7 +74,7 @@ int main(int argc, char *argv[])
 
 	SDL_Surface *screen = SDL_GetWindowSurface(window);
 	SDL_Surface *tmp = IMG_Load("data/box.png");
-	texture = SDL_ConvertSurface(tmp, screen->format, 0);
+	SDL_Surface *image = SDL_ConvertSurface(tmp, screen->format, 0);
 	SDL_FreeSurface(tmp);
 
 	srand(1234);
@@ -89,6 +85,11 @@ int main(int argc, char *argv[])
 
     SoftwareRenderer_init();
 
+    // The texture keeps the channel order of the screen surface.
+    texture = SoftwareRenderer_createTexture(TXF_RGBA8, image->w, image->h);
+    Texture_setImage(texture, image->pixels, image->pitch);
+    SDL_FreeSurface(image);
+
     VertexShader *vshader = SoftwareRenderer_createVertexShader(1, processVertex);
     PixelShader *pshader = SoftwareRenderer_createPixelShader(false, false, 0, 2, drawPixel);
 
@@ -118,7 +119,6 @@ int main(int argc, char *argv[])
 	SDL_Event e;
 	while (SDL_WaitEvent(&e) && e.type != SDL_QUIT);
 
-	SDL_FreeSurface(texture);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include <stdbool.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Storage class of variables with one instance per thread.
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// Sequentially consistent operations on a shared long.
+
+static inline long Atomic_load(volatile long *p)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange(p, 0, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void Atomic_store(volatile long *p, long value)
+{
+#if defined(_MSC_VER)
+    _InterlockedExchange(p, value);
+#else
+    __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Returns the new value.
+static inline long Atomic_add(volatile long *p, long value)
+{
+#if defined(_MSC_VER)
+    return _InterlockedExchangeAdd(p, value) + value;
+#else
+    return __atomic_add_fetch(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Store desired if *p equals expected. Returns true on success.
+static inline bool Atomic_compareExchange(volatile long *p, long expected, long desired)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange(p, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
@@ -0,0 +1,452 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "Coverage.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SR_X86
+#endif
+
+#if defined(SR_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SR_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(SR_X86) && (defined(_MSC_VER) || defined(__GNUC__))
+#define SR_HAVE_AVX
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SR_TARGET_AVX
+#else
+#define SR_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SR_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+typedef uint64_t (*CoverageBlockFunc)(const TriangleEquations *eqn, int x, int y);
+
+// All kernels evaluate an edge as (c + b * y) + a * x at the pixel centers
+// so that they produce identical masks.
+
+static uint64_t Coverage_blockMaskScalar(const TriangleEquations *eqn, int x, int y)
+{
+    const EdgeEquation *edges[3] = { &eqn->e0, &eqn->e1, &eqn->e2 };
+    uint64_t mask = ~(uint64_t)0;
+
+    for (int e = 0; e < 3; ++e)
+    {
+        const EdgeEquation *ee = edges[e];
+        uint64_t edgeMask = 0;
+
+        for (int yy = 0; yy < BlockSize; ++yy)
+        {
+            float base = ee->c + ee->b * (y + yy + 0.5f);
+            for (int xx = 0; xx < BlockSize; ++xx)
+            {
+                float v = base + ee->a * (x + xx + 0.5f);
+                if (EdgeEquation_testValue(ee, v))
+                    edgeMask |= (uint64_t)1 << (yy * BlockSize + xx);
+            }
+        }
+
+        mask &= edgeMask;
+    }
+
+    return mask;
+}
+
+#ifdef SR_HAVE_SSE2
+static uint64_t Coverage_blockMaskSSE2(const TriangleEquations *eqn, int x, int y)
+{
+    const EdgeEquation *edges[3] = { &eqn->e0, &eqn->e1, &eqn->e2 };
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 xLo = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+    const __m128 xHi = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f));
+
+    __m128 a[3], tie[3], axLo[3], axHi[3];
+    for (int e = 0; e < 3; ++e)
+    {
+        a[e] = _mm_set1_ps(edges[e]->a);
+        tie[e] = _mm_castsi128_ps(_mm_set1_epi32(edges[e]->tie ? -1 : 0));
+        axLo[e] = _mm_mul_ps(a[e], xLo);
+        axHi[e] = _mm_mul_ps(a[e], xHi);
+    }
+
+    uint64_t mask = 0;
+    for (int yy = 0; yy < BlockSize; ++yy)
+    {
+        __m128 inLo = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 inHi = inLo;
+
+        for (int e = 0; e < 3; ++e)
+        {
+            __m128 base = _mm_set1_ps(edges[e]->c + edges[e]->b * (y + yy + 0.5f));
+            __m128 vLo = _mm_add_ps(base, axLo[e]);
+            __m128 vHi = _mm_add_ps(base, axHi[e]);
+
+            __m128 tLo = _mm_or_ps(_mm_cmpgt_ps(vLo, zero), _mm_and_ps(_mm_cmpeq_ps(vLo, zero), tie[e]));
+            __m128 tHi = _mm_or_ps(_mm_cmpgt_ps(vHi, zero), _mm_and_ps(_mm_cmpeq_ps(vHi, zero), tie[e]));
+
+            inLo = _mm_and_ps(inLo, tLo);
+            inHi = _mm_and_ps(inHi, tHi);
+        }
+
+        uint64_t row = (uint64_t)(_mm_movemask_ps(inLo) | (_mm_movemask_ps(inHi) << 4));
+        mask |= row << (yy * BlockSize);
+    }
+
+    return mask;
+}
+#endif
+
+#ifdef SR_HAVE_AVX
+SR_TARGET_AVX
+static uint64_t Coverage_blockMaskAVX(const TriangleEquations *eqn, int x, int y)
+{
+    const EdgeEquation *edges[3] = { &eqn->e0, &eqn->e1, &eqn->e2 };
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 xs = _mm256_add_ps(_mm256_set1_ps((float)x), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+
+    __m256 ax[3], tie[3];
+    for (int e = 0; e < 3; ++e)
+    {
+        ax[e] = _mm256_mul_ps(_mm256_set1_ps(edges[e]->a), xs);
+        tie[e] = _mm256_castsi256_ps(_mm256_set1_epi32(edges[e]->tie ? -1 : 0));
+    }
+
+    uint64_t mask = 0;
+    for (int yy = 0; yy < BlockSize; ++yy)
+    {
+        __m256 in = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (int e = 0; e < 3; ++e)
+        {
+            __m256 v = _mm256_add_ps(_mm256_set1_ps(edges[e]->c + edges[e]->b * (y + yy + 0.5f)), ax[e]);
+            __m256 t = _mm256_or_ps(_mm256_cmp_ps(v, zero, _CMP_GT_OQ), _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_EQ_OQ), tie[e]));
+            in = _mm256_and_ps(in, t);
+        }
+
+        mask |= (uint64_t)_mm256_movemask_ps(in) << (yy * BlockSize);
+    }
+
+    return mask;
+}
+
+static bool Coverage_cpuHasAVX()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+#ifdef SR_HAVE_NEON
+static uint64_t Coverage_blockMaskNEON(const TriangleEquations *eqn, int x, int y)
+{
+    const EdgeEquation *edges[3] = { &eqn->e0, &eqn->e1, &eqn->e2 };
+    static const float offsLo[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+    static const float offsHi[4] = { 4.5f, 5.5f, 6.5f, 7.5f };
+    static const uint32_t bits[4] = { 1, 2, 4, 8 };
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t xLo = vaddq_f32(vdupq_n_f32((float)x), vld1q_f32(offsLo));
+    const float32x4_t xHi = vaddq_f32(vdupq_n_f32((float)x), vld1q_f32(offsHi));
+    const uint32x4_t bitv = vld1q_u32(bits);
+
+    float32x4_t axLo[3], axHi[3];
+    uint32x4_t tie[3];
+    for (int e = 0; e < 3; ++e)
+    {
+        float32x4_t a = vdupq_n_f32(edges[e]->a);
+        axLo[e] = vmulq_f32(a, xLo);
+        axHi[e] = vmulq_f32(a, xHi);
+        tie[e] = vdupq_n_u32(edges[e]->tie ? 0xffffffffu : 0);
+    }
+
+    uint64_t mask = 0;
+    for (int yy = 0; yy < BlockSize; ++yy)
+    {
+        uint32x4_t inLo = vdupq_n_u32(0xffffffffu);
+        uint32x4_t inHi = inLo;
+
+        for (int e = 0; e < 3; ++e)
+        {
+            float32x4_t base = vdupq_n_f32(edges[e]->c + edges[e]->b * (y + yy + 0.5f));
+            float32x4_t vLo = vaddq_f32(base, axLo[e]);
+            float32x4_t vHi = vaddq_f32(base, axHi[e]);
+
+            inLo = vandq_u32(inLo, vorrq_u32(vcgtq_f32(vLo, zero), vandq_u32(vceqq_f32(vLo, zero), tie[e])));
+            inHi = vandq_u32(inHi, vorrq_u32(vcgtq_f32(vHi, zero), vandq_u32(vceqq_f32(vHi, zero), tie[e])));
+        }
+
+        uint32x4_t lo = vandq_u32(inLo, bitv);
+        uint32x4_t hi = vandq_u32(inHi, bitv);
+        uint32_t rowLo = vgetq_lane_u32(lo, 0) | vgetq_lane_u32(lo, 1) | vgetq_lane_u32(lo, 2) | vgetq_lane_u32(lo, 3);
+        uint32_t rowHi = vgetq_lane_u32(hi, 0) | vgetq_lane_u32(hi, 1) | vgetq_lane_u32(hi, 2) | vgetq_lane_u32(hi, 3);
+
+        mask |= (uint64_t)(rowLo | (rowHi << 4)) << (yy * BlockSize);
+    }
+
+    return mask;
+}
+#endif
+
+// The fixed point kernels evaluate the edges once per block in 64 bit and
+// step inside the block in 32 bit. The block origin value is clamped to
+// FixedBlockLimit, which keeps its sign exact as long as the in-block steps
+// stay below the limit. Triangles with longer edges are evaluated in 64 bit
+// by Coverage_blockMaskFixed instead.
+static inline int32_t Coverage_fixedOrigin(const FixedEdgeEquation *ee, int x, int y)
+{
+    int64_t v = FixedEdgeEquation_evaluate(ee, x, y);
+    if (v > FixedBlockLimit) return FixedBlockLimit;
+    if (v < -FixedBlockLimit) return -FixedBlockLimit;
+    return (int32_t)v;
+}
+
+#ifdef SR_HAVE_SSE2
+static uint64_t Coverage_blockMaskFixedSSE2(const TriangleEquations *eqn, int x, int y)
+{
+    const FixedEdgeEquation *edges[3] = { &eqn->f0, &eqn->f1, &eqn->f2 };
+    const __m128i minusOne = _mm_set1_epi32(-1);
+
+    __m128i lo[3], hi[3], stepY[3];
+    for (int e = 0; e < 3; ++e)
+    {
+        int32_t a = (int32_t)(edges[e]->a * SubPixelScale);
+        int32_t origin = Coverage_fixedOrigin(edges[e], x, y);
+        lo[e] = _mm_add_epi32(_mm_set1_epi32(origin), _mm_setr_epi32(0, a, 2 * a, 3 * a));
+        hi[e] = _mm_add_epi32(lo[e], _mm_set1_epi32(4 * a));
+        stepY[e] = _mm_set1_epi32((int32_t)(edges[e]->b * SubPixelScale));
+    }
+
+    uint64_t mask = 0;
+    for (int yy = 0; yy < BlockSize; ++yy)
+    {
+        __m128i inLo = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(lo[0], minusOne), _mm_cmpgt_epi32(lo[1], minusOne)), _mm_cmpgt_epi32(lo[2], minusOne));
+        __m128i inHi = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(hi[0], minusOne), _mm_cmpgt_epi32(hi[1], minusOne)), _mm_cmpgt_epi32(hi[2], minusOne));
+
+        uint64_t row = (uint64_t)(_mm_movemask_ps(_mm_castsi128_ps(inLo)) | (_mm_movemask_ps(_mm_castsi128_ps(inHi)) << 4));
+        mask |= row << (yy * BlockSize);
+
+        for (int e = 0; e < 3; ++e)
+        {
+            lo[e] = _mm_add_epi32(lo[e], stepY[e]);
+            hi[e] = _mm_add_epi32(hi[e], stepY[e]);
+        }
+    }
+
+    return mask;
+}
+#endif
+
+static uint64_t Coverage_blockMaskFixedScalar(const TriangleEquations *eqn, int x, int y)
+{
+    const FixedEdgeEquation *edges[3] = { &eqn->f0, &eqn->f1, &eqn->f2 };
+    uint64_t mask = ~(uint64_t)0;
+
+    for (int e = 0; e < 3; ++e)
+    {
+        int32_t a = (int32_t)(edges[e]->a * SubPixelScale);
+        int32_t b = (int32_t)(edges[e]->b * SubPixelScale);
+        int32_t row = Coverage_fixedOrigin(edges[e], x, y);
+        uint64_t edgeMask = 0;
+
+        for (int yy = 0; yy < BlockSize; ++yy, row += b)
+        {
+            int32_t v = row;
+            for (int xx = 0; xx < BlockSize; ++xx, v += a)
+                if (v >= 0)
+                    edgeMask |= (uint64_t)1 << (yy * BlockSize + xx);
+        }
+
+        mask &= edgeMask;
+    }
+
+    return mask;
+}
+
+static CoverageKernel s_kernel = CK_Scalar;
+static CoverageBlockFunc s_blockMask = Coverage_blockMaskScalar;
+static bool s_initialized = false;
+
+void Coverage_init()
+{
+    if (s_initialized)
+        return;
+
+    if (!Coverage_setKernel(CK_AVX))
+        if (!Coverage_setKernel(CK_SSE2))
+            if (!Coverage_setKernel(CK_NEON))
+                Coverage_setKernel(CK_Scalar);
+
+    s_initialized = true;
+}
+
+bool Coverage_setKernel(CoverageKernel kernel)
+{
+    CoverageBlockFunc func = 0;
+
+    switch (kernel)
+    {
+    case CK_Scalar:
+        func = Coverage_blockMaskScalar;
+        break;
+    case CK_SSE2:
+#ifdef SR_HAVE_SSE2
+        func = Coverage_blockMaskSSE2;
+#endif
+        break;
+    case CK_AVX:
+#ifdef SR_HAVE_AVX
+        if (Coverage_cpuHasAVX())
+            func = Coverage_blockMaskAVX;
+#endif
+        break;
+    case CK_NEON:
+#ifdef SR_HAVE_NEON
+        func = Coverage_blockMaskNEON;
+#endif
+        break;
+    }
+
+    if (!func)
+        return false;
+
+    s_kernel = kernel;
+    s_blockMask = func;
+    s_initialized = true;
+    return true;
+}
+
+CoverageKernel Coverage_kernel()
+{
+    return s_kernel;
+}
+
+uint64_t Coverage_blockMask(const TriangleEquations *eqn, int x, int y)
+{
+    return s_blockMask(eqn, x, y);
+}
+
+uint64_t Coverage_blockMaskFixed(const TriangleEquations *eqn, int x, int y)
+{
+    if (!eqn->fixedFitsBlock)
+        return Coverage_rectMask(eqn, x, y, BlockSize, BlockSize, true);
+
+#ifdef SR_HAVE_SSE2
+    if (s_kernel != CK_Scalar)
+        return Coverage_blockMaskFixedSSE2(eqn, x, y);
+#endif
+    return Coverage_blockMaskFixedScalar(eqn, x, y);
+}
+
+CoverageClass Coverage_classifyRect(const TriangleEquations *eqn, int x, int y, int w, int h, bool fixedPoint)
+{
+    int xs[2] = { x, x + w - 1 };
+    int ys[2] = { y, y + h - 1 };
+    bool inside = true;
+
+    for (int e = 0; e < 3; ++e)
+    {
+        int passed = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            int px = xs[i & 1];
+            int py = ys[i >> 1];
+
+            if (fixedPoint)
+            {
+                const FixedEdgeEquation *fe = e == 0 ? &eqn->f0 : e == 1 ? &eqn->f1 : &eqn->f2;
+                passed += FixedEdgeEquation_testValue(FixedEdgeEquation_evaluate(fe, px, py));
+            }
+            else
+            {
+                const EdgeEquation *ee = e == 0 ? &eqn->e0 : e == 1 ? &eqn->e1 : &eqn->e2;
+                float v = (ee->c + ee->b * (py + 0.5f)) + ee->a * (px + 0.5f);
+                passed += EdgeEquation_testValue(ee, v);
+            }
+        }
+
+        if (passed == 0)
+            return CC_Outside;
+        if (passed < 4)
+            inside = false;
+    }
+
+    return inside ? CC_Inside : CC_Partial;
+}
+
+uint64_t Coverage_rectMask(const TriangleEquations *eqn, int x, int y, int w, int h, bool fixedPoint)
+{
+    uint64_t mask = 0;
+
+    if (fixedPoint)
+    {
+        for (int yy = 0; yy < h; ++yy)
+            for (int xx = 0; xx < w; ++xx)
+                if (FixedEdgeEquation_testValue(FixedEdgeEquation_evaluate(&eqn->f0, x + xx, y + yy)) &&
+                    FixedEdgeEquation_testValue(FixedEdgeEquation_evaluate(&eqn->f1, x + xx, y + yy)) &&
+                    FixedEdgeEquation_testValue(FixedEdgeEquation_evaluate(&eqn->f2, x + xx, y + yy)))
+                    mask |= (uint64_t)1 << (yy * BlockSize + xx);
+        return mask;
+    }
+
+    const EdgeEquation *edges[3] = { &eqn->e0, &eqn->e1, &eqn->e2 };
+    mask = ~(uint64_t)0;
+
+    for (int e = 0; e < 3; ++e)
+    {
+        const EdgeEquation *ee = edges[e];
+        uint64_t edgeMask = 0;
+
+        for (int yy = 0; yy < h; ++yy)
+        {
+            float base = ee->c + ee->b * (y + yy + 0.5f);
+            for (int xx = 0; xx < w; ++xx)
+            {
+                float v = base + ee->a * (x + xx + 0.5f);
+                if (EdgeEquation_testValue(ee, v))
+                    edgeMask |= (uint64_t)1 << (yy * BlockSize + xx);
+            }
+        }
+
+        mask &= edgeMask;
+    }
+
+    return mask;
+}
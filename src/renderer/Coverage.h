@@ -0,0 +1,77 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "Renderer.h"
+#include "TriangleEquations.h"
+
+#include <stdint.h>
+
+/// Coverage kernels available for the block rasterizer.
+typedef enum {
+    CK_Scalar,
+    CK_SSE2,
+    CK_AVX,
+    CK_NEON
+} CoverageKernel;
+
+/// Select the fastest coverage kernel supported by the running CPU.
+/** Called by the rasterizer constructor. Calling it again has no effect. */
+void Coverage_init();
+
+/// Force a specific kernel. Returns false if the CPU does not support it.
+bool Coverage_setKernel(CoverageKernel kernel);
+
+/// The kernel currently in use.
+CoverageKernel Coverage_kernel();
+
+/// Compute the coverage mask of the BlockSize x BlockSize block at (x, y).
+/** Bit (yy * BlockSize + xx) is set if the center of pixel (x + xx, y + yy)
+  is inside the triangle according to the edge tie rules. */
+uint64_t Coverage_blockMask(const TriangleEquations *eqn, int x, int y);
+
+/// Same as Coverage_blockMask but uses the fixed point edge equations.
+uint64_t Coverage_blockMaskFixed(const TriangleEquations *eqn, int x, int y);
+
+/// Result of Coverage_classifyRect.
+typedef enum {
+    CC_Outside,
+    CC_Partial,
+    CC_Inside
+} CoverageClass;
+
+/// Classify the pixel centers of the w x h rectangle at (x, y) against the triangle.
+/** Evaluates the edges like the block kernels. That evaluation is monotone
+  in x and y, so testing the corners of the rectangle is exact: CC_Inside
+  means every block mask in it is full and CC_Outside that every one is empty. */
+CoverageClass Coverage_classifyRect(const TriangleEquations *eqn, int x, int y, int w, int h, bool fixedPoint);
+
+/// Coverage of the w x h pixels at (x, y) with w, h <= BlockSize.
+/** Uses the same bit layout as Coverage_blockMask and gives the same result
+  for the pixels it covers. Meant for triangles too small to be worth a block. */
+uint64_t Coverage_rectMask(const TriangleEquations *eqn, int x, int y, int w, int h, bool fixedPoint);
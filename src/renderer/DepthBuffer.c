@@ -0,0 +1,191 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "DepthBuffer.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+void DepthBuffer_construct(DepthBuffer *db)
+{
+    db->m_width = 0;
+    db->m_height = 0;
+    db->m_blocksX = 0;
+    db->m_blocksY = 0;
+    db->m_depth = 0;
+    db->m_minZ = 0;
+    db->m_maxZ = 0;
+}
+
+void DepthBuffer_destruct(DepthBuffer *db)
+{
+    free(db->m_depth);
+    free(db->m_minZ);
+    free(db->m_maxZ);
+    DepthBuffer_construct(db);
+}
+
+void DepthBuffer_reserve(DepthBuffer *db, int width, int height)
+{
+    if (width <= db->m_width && height <= db->m_height)
+        return;
+
+    if (width < db->m_width) width = db->m_width;
+    if (height < db->m_height) height = db->m_height;
+
+    DepthBuffer old = *db;
+
+    db->m_width = width;
+    db->m_height = height;
+    db->m_blocksX = (width + BlockSize - 1) / BlockSize;
+    db->m_blocksY = (height + BlockSize - 1) / BlockSize;
+
+    int blocks = db->m_blocksX * db->m_blocksY;
+    db->m_depth = malloc(sizeof(float) * blocks * BlockSize * BlockSize);
+    db->m_minZ = malloc(sizeof(float) * blocks);
+    db->m_maxZ = malloc(sizeof(float) * blocks);
+
+    DepthBuffer_clear(db, 1.0f);
+
+    // The scissor rect may grow in the middle of a frame, so keep the depth
+    // written so far.
+    for (int by = 0; by < old.m_blocksY; ++by)
+        for (int bx = 0; bx < old.m_blocksX; ++bx)
+        {
+            int from = by * old.m_blocksX + bx;
+            int to = by * db->m_blocksX + bx;
+
+            memcpy(DepthBuffer_block(db, bx * BlockSize, by * BlockSize), DepthBuffer_block(&old, bx * BlockSize, by * BlockSize),
+                sizeof(float) * BlockSize * BlockSize);
+            db->m_minZ[to] = old.m_minZ[from];
+            db->m_maxZ[to] = old.m_maxZ[from];
+        }
+
+    DepthBuffer_destruct(&old);
+}
+
+void DepthBuffer_clear(DepthBuffer *db, float depth)
+{
+    int blocks = db->m_blocksX * db->m_blocksY;
+
+    for (int i = 0; i < blocks * BlockSize * BlockSize; ++i)
+        db->m_depth[i] = depth;
+
+    for (int i = 0; i < blocks; ++i)
+    {
+        db->m_minZ[i] = depth;
+        db->m_maxZ[i] = depth;
+    }
+}
+
+// Depth range of the triangle plane over the pixel centers of a block.
+static inline void DepthBuffer_planeRange(const TriangleEquations *eqn, int x, int y, float *zMin, float *zMax)
+{
+    const ParameterEquation *z = &eqn->z;
+    float z00 = ParameterEquation_evaluate(z, x + 0.5f, y + 0.5f);
+    float dx = z->a * (BlockSize - 1);
+    float dy = z->b * (BlockSize - 1);
+
+    *zMin = z00 + (dx < 0 ? dx : 0) + (dy < 0 ? dy : 0);
+    *zMax = z00 + (dx > 0 ? dx : 0) + (dy > 0 ? dy : 0);
+}
+
+bool DepthBuffer_rejectBlock(const DepthBuffer *db, const TriangleEquations *eqn, int x, int y)
+{
+    float zMin, zMax;
+    DepthBuffer_planeRange(eqn, x, y, &zMin, &zMax);
+    return zMin >= db->m_maxZ[(y / BlockSize) * db->m_blocksX + x / BlockSize];
+}
+
+uint64_t DepthBuffer_testBlock(DepthBuffer *db, const TriangleEquations *eqn, int x, int y, uint64_t mask)
+{
+    int block = (y / BlockSize) * db->m_blocksX + x / BlockSize;
+    float *depth = DepthBuffer_block(db, x, y);
+    const ParameterEquation *z = &eqn->z;
+
+    float zMin, zMax;
+    DepthBuffer_planeRange(eqn, x, y, &zMin, &zMax);
+
+    // Everything covered is in front, no need to compare.
+    bool allPass = zMax < db->m_minZ[block];
+
+    uint64_t result = 0;
+    float newMin = FLT_MAX, newMax = -FLT_MAX;
+
+    float row = ParameterEquation_evaluate(z, x + 0.5f, y + 0.5f);
+    for (int yy = 0; yy < BlockSize; ++yy, row += z->b)
+    {
+        float zv = row;
+        for (int xx = 0; xx < BlockSize; ++xx, zv += z->a)
+        {
+            int i = yy * BlockSize + xx;
+            uint64_t bit = (uint64_t)1 << i;
+
+            if ((mask & bit) && (allPass || zv < depth[i]))
+            {
+                depth[i] = zv;
+                result |= bit;
+            }
+
+            if (depth[i] < newMin) newMin = depth[i];
+            if (depth[i] > newMax) newMax = depth[i];
+        }
+    }
+
+    db->m_minZ[block] = newMin;
+    db->m_maxZ[block] = newMax;
+
+    return result;
+}
+
+uint64_t DepthBuffer_testSpan(DepthBuffer *db, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask)
+{
+    const ParameterEquation *z = &eqn->z;
+    float zv = ParameterEquation_evaluate(z, x + 0.5f, y + 0.5f);
+    uint64_t result = 0;
+
+    for (int i = 0; i < count; ++i, zv += z->a)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+        if (!(mask & bit))
+            continue;
+
+        int px = x + i;
+        float *d = DepthBuffer_block(db, px, y) + (y % BlockSize) * BlockSize + px % BlockSize;
+        if (zv < *d)
+        {
+            *d = zv;
+            result |= bit;
+
+            // Spans of several threads can touch the same block, so the
+            // exact minimum cannot be maintained here. Mark it as unknown
+            // instead, the maximum can only get smaller and stays valid.
+            db->m_minZ[(y / BlockSize) * db->m_blocksX + px / BlockSize] = -FLT_MAX;
+        }
+    }
+
+    return result;
+}
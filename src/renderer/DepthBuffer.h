@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "Renderer.h"
+#include "TriangleEquations.h"
+
+#include <stdint.h>
+
+/// Depth buffer stored in BlockSize x BlockSize blocks with a per block min/max.
+/** The depth test is less. Each block keeps the exact maximum of its depth
+  values, which is used to reject whole blocks. The minimum is used to skip
+  the per pixel compare for blocks the triangle is known to be in front of. */
+typedef struct {
+	int m_width;
+	int m_height;
+	int m_blocksX;
+	int m_blocksY;
+
+	float *m_depth;
+	float *m_minZ;
+	float *m_maxZ;
+} DepthBuffer;
+
+void DepthBuffer_construct(DepthBuffer *db);
+void DepthBuffer_destruct(DepthBuffer *db);
+
+/// Make sure the buffer covers [0, width) x [0, height).
+/** Growing keeps the depth values, the new pixels are set to 1. */
+void DepthBuffer_reserve(DepthBuffer *db, int width, int height);
+
+/// Set all depth values.
+void DepthBuffer_clear(DepthBuffer *db, float depth);
+
+/// Returns true if the triangle is behind everything in the block at (x, y).
+bool DepthBuffer_rejectBlock(const DepthBuffer *db, const TriangleEquations *eqn, int x, int y);
+
+/// Depth test and write the covered pixels of the block at (x, y).
+/** Returns the mask of the pixels that passed. */
+uint64_t DepthBuffer_testBlock(DepthBuffer *db, const TriangleEquations *eqn, int x, int y, uint64_t mask);
+
+/// Depth test and write count <= 64 pixels of a span starting at (x, y).
+uint64_t DepthBuffer_testSpan(DepthBuffer *db, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask);
+
+static inline float *DepthBuffer_block(const DepthBuffer *db, int x, int y)
+{
+    return db->m_depth + ((y / BlockSize) * db->m_blocksX + x / BlockSize) * BlockSize * BlockSize;
+}
@@ -27,6 +27,11 @@ SOFTWARE.
 #include "Renderer.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+/// Number of fractional bits of the snapped vertex positions (28.4).
+enum { SubPixelBits = 4, SubPixelScale = 1 << SubPixelBits };
 
 typedef struct EdgeEquation {
 	float a;
@@ -83,4 +88,60 @@ static inline float EdgeEquation_stepY(const EdgeEquation *ee, float v)
 static inline float EdgeEquation_stepY2(const EdgeEquation *ee, float v, float stepSize)
 {
     return v + ee->b * stepSize;
-}
\ No newline at end of file
+}
+
+/// Edge equation on vertex positions snapped to the sub-pixel grid.
+/** All values are exact integers in units of 1 / (SubPixelScale * SubPixelScale)
+  pixels. The tie rule is folded into c so a point is inside iff the
+  evaluated value is >= 0. */
+typedef struct FixedEdgeEquation {
+	int64_t a;
+	int64_t b;
+	int64_t c;
+} FixedEdgeEquation;
+
+// Snap a coordinate to the sub-pixel grid.
+static inline int64_t FixedEdgeEquation_snap(float v)
+{
+    return (int64_t)floorf(v * SubPixelScale + 0.5f);
+}
+
+// Returns the unbiased c so the caller can compute the triangle area from it.
+static inline int64_t FixedEdgeEquation_init(FixedEdgeEquation *ee, int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+{
+    ee->a = y0 - y1;
+    ee->b = x1 - x0;
+    int64_t c = -(ee->a * x0 + ee->b * y0);
+
+    // Same top-left rule as EdgeEquation, but exact. Points on an edge
+    // without the tie flag are moved outside by one unit.
+    bool tie = ee->a != 0 ? ee->a > 0 : ee->b > 0;
+    ee->c = tie ? c : c - 1;
+    return c;
+}
+
+// Evaluate the edge equation at the center of the given pixel.
+static inline int64_t FixedEdgeEquation_evaluate(const FixedEdgeEquation *ee, int x, int y)
+{
+    int64_t px = (int64_t)x * SubPixelScale + SubPixelScale / 2;
+    int64_t py = (int64_t)y * SubPixelScale + SubPixelScale / 2;
+    return ee->a * px + ee->b * py + ee->c;
+}
+
+/// Limit of the block origin value used by the 32 bit block kernels.
+enum { FixedBlockLimit = 1 << 30 };
+
+// Returns true if the steps across a block stay below FixedBlockLimit, so
+// a block can be stepped in 32 bit from an origin clamped to the limit.
+static inline bool FixedEdgeEquation_fitsBlock(const FixedEdgeEquation *ee)
+{
+    int64_t a = ee->a < 0 ? -ee->a : ee->a;
+    int64_t b = ee->b < 0 ? -ee->b : ee->b;
+    return (a + b) * SubPixelScale * (BlockSize - 1) < FixedBlockLimit;
+}
+
+// Test for a given evaluated value.
+static inline bool FixedEdgeEquation_testValue(int64_t v)
+{
+    return v >= 0;
+}
@@ -0,0 +1,370 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "JobSystem.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+/// Capacity of the deque of each thread. Must be a power of two.
+enum { JobQueueSize = 4096 };
+
+/// Chunks per thread created by JobSystem_parallelFor for load balancing.
+enum { ChunksPerThread = 4 };
+
+#if defined(_WIN32)
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Cond;
+typedef HANDLE Thread;
+#define Mutex_init(m) InitializeCriticalSection(m)
+#define Mutex_destroy(m) DeleteCriticalSection(m)
+#define Mutex_lock(m) EnterCriticalSection(m)
+#define Mutex_unlock(m) LeaveCriticalSection(m)
+#define Cond_init(c) InitializeConditionVariable(c)
+#define Cond_destroy(c) ((void)(c))
+#define Cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define Cond_signal(c) WakeConditionVariable(c)
+#define Cond_broadcast(c) WakeAllConditionVariable(c)
+#define Thread_yield() SwitchToThread()
+#else
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+typedef pthread_t Thread;
+#define Mutex_init(m) pthread_mutex_init(m, 0)
+#define Mutex_destroy(m) pthread_mutex_destroy(m)
+#define Mutex_lock(m) pthread_mutex_lock(m)
+#define Mutex_unlock(m) pthread_mutex_unlock(m)
+#define Cond_init(c) pthread_cond_init(c, 0)
+#define Cond_destroy(c) pthread_cond_destroy(c)
+#define Cond_wait(c, m) pthread_cond_wait(c, m)
+#define Cond_signal(c) pthread_cond_signal(c)
+#define Cond_broadcast(c) pthread_cond_broadcast(c)
+#define Thread_yield() sched_yield()
+#endif
+
+typedef struct Job {
+	JobFunc func;
+	void *data;
+	int begin;
+	int end;
+	JobCounter *counter;
+	bool background;
+} Job;
+
+// The owner pushes and pops at the bottom, thieves take from the top.
+typedef struct JobQueue {
+	Mutex lock;
+	int top;
+	int bottom;
+	Job jobs[JobQueueSize];
+} JobQueue;
+
+static struct {
+	int threadCount;
+	// One deque per thread. Threads outside the pool share deque 0.
+	JobQueue *queues;
+	Thread *threads;
+
+	// Workers sleep while no job is queued.
+	Mutex sleepLock;
+	Cond sleepCond;
+	volatile long queued;
+	volatile long quit;
+} g_jobs;
+
+static THREAD_LOCAL int t_queueIndex;
+
+static int processorCount()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+static bool JobQueue_push(JobQueue *q, const Job *job)
+{
+    Mutex_lock(&q->lock);
+    bool full = q->bottom - q->top == JobQueueSize;
+    if (!full)
+        q->jobs[q->bottom++ & (JobQueueSize - 1)] = *job;
+    Mutex_unlock(&q->lock);
+    return !full;
+}
+
+// A thread waiting on a counter only runs background jobs of that counter.
+// Workers pass a null counter and run every job.
+static bool Job_runnable(const Job *job, const JobCounter *waiting)
+{
+    return !waiting || !job->background || job->counter == waiting;
+}
+
+static bool JobQueue_pop(JobQueue *q, Job *job, const JobCounter *waiting)
+{
+    Mutex_lock(&q->lock);
+    bool found = q->bottom != q->top && Job_runnable(&q->jobs[(q->bottom - 1) & (JobQueueSize - 1)], waiting);
+    if (found)
+        *job = q->jobs[--q->bottom & (JobQueueSize - 1)];
+    Mutex_unlock(&q->lock);
+    return found;
+}
+
+static bool JobQueue_steal(JobQueue *q, Job *job, const JobCounter *waiting)
+{
+    Mutex_lock(&q->lock);
+    bool found = q->bottom != q->top && Job_runnable(&q->jobs[q->top & (JobQueueSize - 1)], waiting);
+    if (found)
+        *job = q->jobs[q->top++ & (JobQueueSize - 1)];
+    Mutex_unlock(&q->lock);
+    return found;
+}
+
+// Take a job from the own deque or steal one from another thread. A waiting
+// thread also looks at the top of its own deque, since a background job may
+// block the bottom.
+static bool JobSystem_take(Job *job, const JobCounter *waiting)
+{
+    if (Atomic_load(&g_jobs.queued) == 0)
+        return false;
+
+    int self = t_queueIndex;
+    bool found = JobQueue_pop(&g_jobs.queues[self], job, waiting);
+
+    for (int i = waiting ? 0 : 1; i < g_jobs.threadCount && !found; ++i)
+        found = JobQueue_steal(&g_jobs.queues[(self + i) % g_jobs.threadCount], job, waiting);
+
+    if (found)
+        Atomic_add(&g_jobs.queued, -1);
+
+    return found;
+}
+
+static void JobSystem_execute(const Job *job)
+{
+    job->func(job->data, job->begin, job->end);
+    Atomic_add(&job->counter->pending, -1);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI JobSystem_worker(LPVOID arg)
+#else
+static void *JobSystem_worker(void *arg)
+#endif
+{
+    t_queueIndex = (int)(size_t)arg;
+
+    while (!Atomic_load(&g_jobs.quit))
+    {
+        Job job;
+        if (JobSystem_take(&job, 0))
+        {
+            JobSystem_execute(&job);
+            continue;
+        }
+
+        Mutex_lock(&g_jobs.sleepLock);
+        while (Atomic_load(&g_jobs.queued) == 0 && !Atomic_load(&g_jobs.quit))
+            Cond_wait(&g_jobs.sleepCond, &g_jobs.sleepLock);
+        Mutex_unlock(&g_jobs.sleepLock);
+    }
+
+    return 0;
+}
+
+void JobSystem_init(int threadCount)
+{
+    if (g_jobs.threadCount)
+        JobSystem_shutdown();
+
+    if (threadCount <= 0)
+        threadCount = processorCount();
+
+    g_jobs.queued = 0;
+    g_jobs.quit = 0;
+    g_jobs.queues = malloc(sizeof(JobQueue) * threadCount);
+    g_jobs.threads = malloc(sizeof(Thread) * threadCount);
+    t_queueIndex = 0;
+
+    // Without the pool all jobs run on the calling thread.
+    if (!g_jobs.queues || !g_jobs.threads)
+    {
+        free(g_jobs.queues);
+        free(g_jobs.threads);
+        g_jobs.queues = 0;
+        g_jobs.threads = 0;
+        return;
+    }
+
+    Mutex_init(&g_jobs.sleepLock);
+    Cond_init(&g_jobs.sleepCond);
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        Mutex_init(&g_jobs.queues[i].lock);
+        g_jobs.queues[i].top = 0;
+        g_jobs.queues[i].bottom = 0;
+    }
+
+    // The calling thread works on deque 0 while it waits.
+    int created = 1;
+    for (; created < threadCount; ++created)
+    {
+#if defined(_WIN32)
+        g_jobs.threads[created] = CreateThread(0, 0, JobSystem_worker, (LPVOID)(size_t)created, 0, 0);
+        if (!g_jobs.threads[created])
+            break;
+#else
+        if (pthread_create(&g_jobs.threads[created], 0, JobSystem_worker, (void*)(size_t)created) != 0)
+            break;
+#endif
+    }
+
+    // Go on with the threads that could be started. The workers only look
+    // at the thread count once a job is queued.
+    for (int i = created; i < threadCount; ++i)
+        Mutex_destroy(&g_jobs.queues[i].lock);
+
+    g_jobs.threadCount = created;
+}
+
+void JobSystem_shutdown()
+{
+    if (!g_jobs.threadCount)
+        return;
+
+    Mutex_lock(&g_jobs.sleepLock);
+    Atomic_store(&g_jobs.quit, 1);
+    Cond_broadcast(&g_jobs.sleepCond);
+    Mutex_unlock(&g_jobs.sleepLock);
+
+    for (int i = 1; i < g_jobs.threadCount; ++i)
+    {
+#if defined(_WIN32)
+        WaitForSingleObject(g_jobs.threads[i], INFINITE);
+        CloseHandle(g_jobs.threads[i]);
+#else
+        pthread_join(g_jobs.threads[i], 0);
+#endif
+    }
+
+    for (int i = 0; i < g_jobs.threadCount; ++i)
+        Mutex_destroy(&g_jobs.queues[i].lock);
+
+    Mutex_destroy(&g_jobs.sleepLock);
+    Cond_destroy(&g_jobs.sleepCond);
+
+    free(g_jobs.queues);
+    free(g_jobs.threads);
+    g_jobs.queues = 0;
+    g_jobs.threads = 0;
+    g_jobs.threadCount = 0;
+}
+
+int JobSystem_threadCount()
+{
+    return g_jobs.threadCount ? g_jobs.threadCount : 1;
+}
+
+static void JobSystem_push(JobCounter *counter, JobFunc func, void *data, int begin, int end, bool background)
+{
+    Job job = { func, data, begin, end, counter, background };
+    Atomic_add(&counter->pending, 1);
+
+    // Without workers or with a full deque the job runs right away.
+    if (g_jobs.threadCount <= 1 || !JobQueue_push(&g_jobs.queues[t_queueIndex], &job))
+    {
+        JobSystem_execute(&job);
+        return;
+    }
+
+    Atomic_add(&g_jobs.queued, 1);
+
+    Mutex_lock(&g_jobs.sleepLock);
+    Cond_signal(&g_jobs.sleepCond);
+    Mutex_unlock(&g_jobs.sleepLock);
+}
+
+void JobSystem_submit(JobCounter *counter, JobFunc func, void *data, int begin, int end)
+{
+    JobSystem_push(counter, func, data, begin, end, false);
+}
+
+void JobSystem_submitBackground(JobCounter *counter, JobFunc func, void *data, int begin, int end)
+{
+    JobSystem_push(counter, func, data, begin, end, true);
+}
+
+void JobSystem_wait(JobCounter *counter)
+{
+    while (Atomic_load(&counter->pending) > 0)
+    {
+        Job job;
+        if (JobSystem_take(&job, counter))
+            JobSystem_execute(&job);
+        else
+            Thread_yield();
+    }
+}
+
+void JobSystem_parallelFor(int count, int grain, JobFunc func, void *data)
+{
+    if (count <= 0)
+        return;
+
+    int threads = JobSystem_threadCount();
+    if (threads == 1 || count <= grain)
+    {
+        func(data, 0, count);
+        return;
+    }
+
+    int chunks = threads * ChunksPerThread;
+    int chunkSize = max(grain, (count + chunks - 1) / chunks);
+
+    JobCounter counter = { 0 };
+    for (int begin = 0; begin < count; begin += chunkSize)
+        JobSystem_submit(&counter, func, data, begin, min(begin + chunkSize, count));
+
+    JobSystem_wait(&counter);
+}
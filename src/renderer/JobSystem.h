@@ -0,0 +1,65 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "Atomic.h"
+
+/// Function run by a job on the range [begin, end).
+typedef void (*JobFunc)(void *data, int begin, int end);
+
+/// Counts the unfinished jobs of a group.
+typedef struct JobCounter {
+	volatile long pending;
+} JobCounter;
+
+/// Start the worker threads. threadCount includes the calling thread.
+/** 0 uses one thread per processor. With 1 all jobs run on the calling thread.
+  If memory or threads run out fewer threads are used. */
+void JobSystem_init(int threadCount);
+
+/// Stop and join the worker threads.
+void JobSystem_shutdown();
+
+/// Number of threads working on jobs including the calling thread.
+int JobSystem_threadCount();
+
+/// Queue func(data, begin, end) on the deque of the calling thread.
+/** Idle threads steal from the other end of the deque. */
+void JobSystem_submit(JobCounter *counter, JobFunc func, void *data, int begin, int end);
+
+/// Like JobSystem_submit, but only workers and waits on counter run the job.
+/** Meant for long jobs such as a front end chunk, which would otherwise
+  stall a thread that picks them up while waiting on short jobs. */
+void JobSystem_submitBackground(JobCounter *counter, JobFunc func, void *data, int begin, int end);
+
+/// Wait until all jobs of the counter are done.
+/** Runs queued jobs while waiting, except background jobs of other counters. */
+void JobSystem_wait(JobCounter *counter);
+
+/// Run func over [0, count) split into ranges of at least grain elements and wait.
+void JobSystem_parallelFor(int count, int grain, JobFunc func, void *data);
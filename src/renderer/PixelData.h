@@ -34,6 +34,8 @@ SOFTWARE.
 // Initialize pixel data for the given pixel coordinates.
 inline void PixelData_init(PixelData *pd, const TriangleEquations *eqn, float x, float y, int aVarCount, int pVarCount, bool interpolateZ, bool interpolateW)
 {
+    pd->equations = eqn;
+
     if (interpolateZ)
         pd->z = ParameterEquation_evaluate(&eqn->z, x, y);
 
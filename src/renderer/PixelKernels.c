@@ -0,0 +1,192 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "PixelKernels.h"
+
+// Every kernel below is compiled with constant interpolation settings.
+// The interpolation code is written out here and forced inline, so the
+// branches on the settings go away and the variable loops have constant
+// counts even where the compiler would not inline on its own. Batch
+// callbacks still take the generic SoA path.
+
+#if defined(_MSC_VER)
+#define PIXEL_KERNEL_INLINE static __forceinline
+#elif defined(__GNUC__)
+#define PIXEL_KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define PIXEL_KERNEL_INLINE static inline
+#endif
+
+PIXEL_KERNEL_INLINE void PixelKernel_init(PixelData *pd, const TriangleEquations *eqn, float x, float y, int z, int w, int a, int p)
+{
+    pd->equations = eqn;
+    if (z) pd->z = eqn->z.a * x + eqn->z.b * y + eqn->z.c;
+    if (w || p > 0)
+    {
+        pd->invw = eqn->invw.a * x + eqn->invw.b * y + eqn->invw.c;
+        pd->w = 1.0f / pd->invw;
+    }
+    for (int i = 0; i < a; ++i)
+        pd->avar[i] = eqn->avar[i].a * x + eqn->avar[i].b * y + eqn->avar[i].c;
+    for (int i = 0; i < p; ++i)
+    {
+        pd->pvarTemp[i] = eqn->pvar[i].a * x + eqn->pvar[i].b * y + eqn->pvar[i].c;
+        pd->pvar[i] = pd->pvarTemp[i] * pd->w;
+    }
+}
+
+// Step by one pixel in x, or in y if stepY is set.
+PIXEL_KERNEL_INLINE void PixelKernel_step(PixelData *pd, const TriangleEquations *eqn, int stepY, int z, int w, int a, int p)
+{
+    if (z) pd->z += stepY ? eqn->z.b : eqn->z.a;
+    if (w || p > 0)
+    {
+        pd->invw += stepY ? eqn->invw.b : eqn->invw.a;
+        pd->w = 1.0f / pd->invw;
+    }
+    for (int i = 0; i < a; ++i)
+        pd->avar[i] += stepY ? eqn->avar[i].b : eqn->avar[i].a;
+    for (int i = 0; i < p; ++i)
+    {
+        pd->pvarTemp[i] += stepY ? eqn->pvar[i].b : eqn->pvar[i].a;
+        pd->pvar[i] = pd->pvarTemp[i] * pd->w;
+    }
+}
+
+PIXEL_KERNEL_INLINE void PixelKernel_copy(PixelData *pi, const PixelData *po, int z, int w, int a, int p)
+{
+    pi->equations = po->equations;
+    if (z) pi->z = po->z;
+    if (w || p > 0)
+    {
+        pi->invw = po->invw;
+        pi->w = po->w;
+    }
+    for (int i = 0; i < a; ++i)
+        pi->avar[i] = po->avar[i];
+    for (int i = 0; i < p; ++i)
+    {
+        pi->pvarTemp[i] = po->pvarTemp[i];
+        pi->pvar[i] = po->pvar[i];
+    }
+}
+
+#define PIXEL_KERNEL(Z, W, A, P) \
+static void PixelKernel_drawBlock_##Z##_##W##_##A##_##P(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, uint64_t mask) \
+{ \
+    if (ps->drawPixelBatch) \
+    { \
+        PixelShader_drawBlockBatch(ps, output, eqn, x, y, mask); \
+        return; \
+    } \
+    if (!ps->drawPixel) \
+        return; \
+\
+    PixelData po; \
+    PixelKernel_init(&po, eqn, x + 0.5f, y + 0.5f, Z, W, A, P); \
+\
+    for (int yy = y; yy < y + BlockSize; yy++) \
+    { \
+        PixelData pi; \
+        PixelKernel_copy(&pi, &po, Z, W, A, P); \
+        pi.y = yy; \
+\
+        for (int xx = x; xx < x + BlockSize; xx++) \
+        { \
+            if (mask & 1) \
+            { \
+                pi.x = xx; \
+                ps->drawPixel(&pi); \
+            } \
+            mask >>= 1; \
+\
+            PixelKernel_step(&pi, eqn, 0, Z, W, A, P); \
+        } \
+\
+        PixelKernel_step(&po, eqn, 1, Z, W, A, P); \
+    } \
+} \
+\
+static void PixelKernel_drawSpanMask_##Z##_##W##_##A##_##P(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask) \
+{ \
+    if (ps->drawPixelBatch) \
+    { \
+        PixelShader_drawSpanBatch(ps, output, eqn, x, y, count, mask); \
+        return; \
+    } \
+    if (!ps->drawPixel) \
+        return; \
+\
+    PixelData p; \
+    p.y = y; \
+    PixelKernel_init(&p, eqn, x + 0.5f, y + 0.5f, Z, W, A, P); \
+\
+    for (int i = 0; i < count; ++i) \
+    { \
+        if (mask & 1) \
+        { \
+            p.x = x + i; \
+            ps->drawPixel(&p); \
+        } \
+        mask >>= 1; \
+\
+        PixelKernel_step(&p, eqn, 0, Z, W, A, P); \
+    } \
+}
+
+#define PIXEL_KERNEL_KEY(Z, W, A, P) ((((Z) * 2 + (W)) * (MaxKernelAVars + 1) + (A)) * (MaxKernelPVars + 1) + (P))
+
+#define PIXEL_KERNEL_CASE(Z, W, A, P) \
+    case PIXEL_KERNEL_KEY(Z, W, A, P): \
+        kernels.drawBlock = PixelKernel_drawBlock_##Z##_##W##_##A##_##P; \
+        kernels.drawSpanMask = PixelKernel_drawSpanMask_##Z##_##W##_##A##_##P; \
+        break;
+
+// Expand X for every combination of settings with a specialized kernel.
+#define PIXEL_KERNEL_LIST_P(X, Z, W, A) X(Z, W, A, 0) X(Z, W, A, 1) X(Z, W, A, 2) X(Z, W, A, 3)
+#define PIXEL_KERNEL_LIST_A(X, Z, W) \
+    PIXEL_KERNEL_LIST_P(X, Z, W, 0) PIXEL_KERNEL_LIST_P(X, Z, W, 1) \
+    PIXEL_KERNEL_LIST_P(X, Z, W, 2) PIXEL_KERNEL_LIST_P(X, Z, W, 3)
+#define PIXEL_KERNEL_LIST(X) \
+    PIXEL_KERNEL_LIST_A(X, 0, 0) PIXEL_KERNEL_LIST_A(X, 0, 1) \
+    PIXEL_KERNEL_LIST_A(X, 1, 0) PIXEL_KERNEL_LIST_A(X, 1, 1)
+
+PIXEL_KERNEL_LIST(PIXEL_KERNEL)
+
+PixelKernels PixelKernels_select(const PixelShader *ps)
+{
+    PixelKernels kernels = { PixelShader_drawBlock, PixelShader_drawSpanMask };
+
+    if (!ps || ps->AVarCount > MaxKernelAVars || ps->PVarCount > MaxKernelPVars ||
+        PixelShader_subdividePerspective(ps))
+        return kernels;
+
+    switch (PIXEL_KERNEL_KEY(ps->InterpolateZ ? 1 : 0, ps->InterpolateW ? 1 : 0, ps->AVarCount, ps->PVarCount))
+    {
+        PIXEL_KERNEL_LIST(PIXEL_KERNEL_CASE)
+    }
+
+    return kernels;
+}
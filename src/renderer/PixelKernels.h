@@ -0,0 +1,47 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "PixelShader.h"
+
+/// Specialized kernels exist for up to this many affine and perspective variables.
+enum { MaxKernelAVars = 3, MaxKernelPVars = 3 };
+
+typedef void (*DrawBlockFunc)(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, uint64_t mask);
+typedef void (*DrawSpanMaskFunc)(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask);
+
+/// Pixel loops used by the rasterizer for one pixel shader signature.
+typedef struct PixelKernels {
+	DrawBlockFunc drawBlock;
+	DrawSpanMaskFunc drawSpanMask;
+} PixelKernels;
+
+/// Select the kernels compiled for the interpolation settings of the pixel shader.
+/** Falls back to PixelShader_drawBlock and PixelShader_drawSpanMask if
+  there is no specialized kernel for the settings or if ps is null. */
+PixelKernels PixelKernels_select(const PixelShader *ps);
@@ -25,7 +25,23 @@ SOFTWARE.
 #pragma once
 
 #include "PixelShader.h"
-#include "EdgeData.h"
+#include "RenderTarget.h"
+
+#include <float.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SR_X86
+#endif
+
+#if defined(SR_X86) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define SR_HAVE_SSE
+#include <xmmintrin.h>
+#endif
+
+// External definitions for the calls the compiler does not inline.
+extern inline void PixelData_init(PixelData *pd, const TriangleEquations *eqn, float x, float y, int aVarCount, int pVarCount, bool interpolateZ, bool interpolateW);
+extern inline void PixelData_stepX(PixelData *pd, const TriangleEquations *eqn, int aVarCount, int pVarCount, bool interpolateZ, bool interpolateW);
+extern inline void PixelData_stepY(PixelData *pd, const TriangleEquations *eqn, int aVarCount, int pVarCount, bool interpolateZ, bool interpolateW);
 
 void PixelShader_init(PixelShader *ps, int interpZ, int interpW, int affineVarCount, int perspVarCount, DrawPixelCallback callback)
 {
@@ -34,51 +50,109 @@ void PixelShader_init(PixelShader *ps, int interpZ, int interpW, int affineVarCo
     ps->AVarCount = affineVarCount;
     ps->PVarCount = perspVarCount;
     ps->drawPixel = callback;
+    ps->Revision++;
+}
+
+void PixelShader_setDrawPixelBatch(PixelShader *ps, DrawPixelBatchCallback callback)
+{
+    ps->drawPixelBatch = callback;
+}
+
+void PixelShader_setPerspectiveStep(PixelShader *ps, int step, float maxError)
+{
+    ps->PerspectiveStep = step > 1 ? step : 0;
+    ps->PerspectiveMaxError = maxError > 0.0f ? maxError : 0.0f;
+    ps->Revision++;
+}
+
+void PixelShader_setFastReciprocal(PixelShader *ps, bool enable)
+{
+    ps->FastReciprocal = enable;
+}
+
+static inline float PixelShader_reciprocal(const PixelShader *ps, float x)
+{
+#ifdef SR_HAVE_SSE
+    if (ps->FastReciprocal)
+    {
+        // 12 bit estimate, one Newton-Raphson step gives about 23 bits.
+        float r = _mm_cvtss_f32(_mm_rcp_ss(_mm_set_ss(x)));
+        return r * (2.0f - x * r);
+    }
+#endif
+    return 1.0f / x;
 }
 
-void PixelShader_drawBlock(PixelShader *ps, const TriangleEquations *eqn, int x, int y, bool testEdges)
+void PixelShader_drawBlock(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, uint64_t mask)
 {
+    if (ps->drawPixelBatch)
+    {
+        PixelShader_drawBlockBatch(ps, output, eqn, x, y, mask);
+        return;
+    }
+
     float xf = x + 0.5f;
     float yf = y + 0.5f;
 
     PixelData po;
     PixelData_init(&po, eqn, xf, yf, ps->AVarCount, ps->PVarCount, ps->InterpolateZ, ps->InterpolateW);
 
-    EdgeData eo;
-    if (testEdges)
-        EdgeData_init(&eo, eqn, xf, yf);
+    bool subdivide = PixelShader_subdividePerspective(ps);
 
     for (int yy = y; yy < y + BlockSize; yy++)
     {
         PixelData pi = PixelShader_copyPixelData(ps, &po);
 
-        EdgeData ei;
-        if (testEdges)
-            ei = eo;
+        if (subdivide)
+        {
+            pi.x = x;
+            pi.y = yy;
+            PixelShader_drawRowSubdivided(ps, eqn, &pi, BlockSize, mask & ((1 << BlockSize) - 1));
+            mask >>= BlockSize;
+
+            PixelData_stepY(&po, eqn, ps->AVarCount, ps->PVarCount, ps->InterpolateZ, ps->InterpolateW);
+            continue;
+        }
 
         for (int xx = x; xx < x + BlockSize; xx++)
         {
-            if (!testEdges || EdgeData_test(&ei, eqn))
+            if (mask & 1)
             {
                 pi.x = xx;
                 pi.y = yy;
                 if (ps->drawPixel)
                     ps->drawPixel(&pi);
             }
+            mask >>= 1;
 
             PixelData_stepX(&pi, eqn, ps->AVarCount, ps->PVarCount, ps->InterpolateZ, ps->InterpolateW);
-            if (testEdges)
-                EdgeData_stepX(&ei, eqn);
         }
 
         PixelData_stepY(&po, eqn, ps->AVarCount, ps->PVarCount, ps->InterpolateZ, ps->InterpolateW);
-        if (testEdges)
-            EdgeData_stepY(&eo, eqn);
     }
 }
 
-void PixelShader_drawSpan(PixelShader *ps, const TriangleEquations *eqn, int x, int y, int x2)
+void PixelShader_drawSpan(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int x2)
+{
+    while (x < x2)
+    {
+        int n = x2 - x < PixelBatchSize ? x2 - x : PixelBatchSize;
+        uint64_t mask = n == PixelBatchSize ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+
+        PixelShader_drawSpanMask(ps, output, eqn, x, y, n, mask);
+
+        x += n;
+    }
+}
+
+void PixelShader_drawSpanMask(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask)
 {
+    if (ps->drawPixelBatch)
+    {
+        PixelShader_drawSpanBatch(ps, output, eqn, x, y, count, mask);
+        return;
+    }
+
     float xf = x + 0.5f;
     float yf = y + 0.5f;
 
@@ -86,23 +160,248 @@ void PixelShader_drawSpan(PixelShader *ps, const TriangleEquations *eqn, int x,
     p.y = y;
     PixelData_init(&p, eqn, xf, yf, ps->AVarCount, ps->PVarCount, ps->InterpolateZ, ps->InterpolateW);
 
-    while (x < x2)
+    if (PixelShader_subdividePerspective(ps))
     {
         p.x = x;
-        if (ps->drawPixel)
-            ps->drawPixel(&p);
+        PixelShader_drawRowSubdivided(ps, eqn, &p, count, mask);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (mask & 1)
+        {
+            p.x = x + i;
+            if (ps->drawPixel)
+                ps->drawPixel(&p);
+        }
+        mask >>= 1;
+
         PixelData_stepX(&p, eqn, ps->AVarCount, ps->PVarCount, ps->InterpolateZ, ps->InterpolateW);
-        x++;
+    }
+}
+
+void PixelShader_drawRowSubdivided(PixelShader *ps, const TriangleEquations *eqn, PixelData *p, int count, uint64_t mask)
+{
+    if (!ps->drawPixel)
+        return;
+
+    // Linear interpolation of the perspective vars between two pixels whose
+    // 1/w ratio is q is off by at most |sqrt(q) - 1| / (sqrt(q) + 1) of their
+    // change. Steps are halved until q lies in [1 / bound, bound].
+    float bound = FLT_MAX;
+    if (ps->PerspectiveMaxError < 1.0f)
+    {
+        float k = (1.0f + ps->PerspectiveMaxError) / (1.0f - ps->PerspectiveMaxError);
+        bound = k * k;
+    }
+
+    int x = p->x;
+    float w0 = PixelShader_reciprocal(ps, p->invw);
+    float pvar0[MaxPVars];
+    for (int i = 0; i < ps->PVarCount; ++i)
+        pvar0[i] = p->pvarTemp[i] * w0;
+
+    for (int first = 0; first < count; )
+    {
+        int n = count - first < ps->PerspectiveStep ? count - first : ps->PerspectiveStep;
+        float invw1 = p->invw + n * eqn->invw.a;
+        while (n > 1 && !(invw1 <= bound * p->invw && invw1 * bound >= p->invw))
+        {
+            n >>= 1;
+            invw1 = p->invw + n * eqn->invw.a;
+        }
+
+        float w1 = PixelShader_reciprocal(ps, invw1);
+        float invn = 1.0f / n;
+        float dw = (w1 - w0) * invn;
+
+        float pvar1[MaxPVars];
+        float dpvar[MaxPVars];
+        for (int i = 0; i < ps->PVarCount; ++i)
+        {
+            pvar1[i] = (p->pvarTemp[i] + n * eqn->pvar[i].a) * w1;
+            dpvar[i] = (pvar1[i] - pvar0[i]) * invn;
+            p->pvar[i] = pvar0[i];
+        }
+        p->w = w0;
+
+        for (int j = 0; j < n; ++j)
+        {
+            if (mask & 1)
+            {
+                p->x = x + first + j;
+                ps->drawPixel(p);
+            }
+            mask >>= 1;
+
+            if (ps->InterpolateZ)
+                p->z = ParameterEquation_stepX(&eqn->z, p->z);
+            p->invw = ParameterEquation_stepX(&eqn->invw, p->invw);
+            p->w += dw;
+            for (int i = 0; i < ps->AVarCount; ++i)
+                p->avar[i] = ParameterEquation_stepX(&eqn->avar[i], p->avar[i]);
+            for (int i = 0; i < ps->PVarCount; ++i)
+            {
+                p->pvarTemp[i] = ParameterEquation_stepX(&eqn->pvar[i], p->pvarTemp[i]);
+                p->pvar[i] += dpvar[i];
+            }
+        }
+
+        w0 = w1;
+        for (int i = 0; i < ps->PVarCount; ++i)
+            pvar0[i] = pvar1[i];
+        first += n;
     }
 }
 
 PixelData PixelShader_copyPixelData(PixelShader *ps, PixelData *po)
 {
     PixelData pi;
+    pi.equations = po->equations;
     if (ps->InterpolateZ) pi.z = po->z;
-    if (ps->InterpolateW) pi.invw = po->invw;
+    if (ps->InterpolateW || ps->PVarCount > 0)
+    {
+        pi.invw = po->invw;
+        pi.w = po->w;
+    }
     for (int i = 0; i < ps->AVarCount; ++i)
         pi.avar[i] = po->avar[i];
+    for (int i = 0; i < ps->PVarCount; ++i)
+    {
+        pi.pvarTemp[i] = po->pvarTemp[i];
+        pi.pvar[i] = po->pvar[i];
+    }
     return pi;
 }
 
+void PixelShader_interpolateBatch(PixelShader *ps, const TriangleEquations *eqn, PixelBatch *batch)
+{
+    int n = batch->count;
+    batch->equations = eqn;
+
+    // Sample at pixel centers.
+    float xf[PixelBatchSize], yf[PixelBatchSize];
+    for (int i = 0; i < n; ++i)
+    {
+        xf[i] = batch->x[i] + 0.5f;
+        yf[i] = batch->y[i] + 0.5f;
+    }
+
+    if (ps->InterpolateZ)
+    {
+        const ParameterEquation *pe = &eqn->z;
+        for (int i = 0; i < n; ++i)
+            batch->z[i] = pe->a * xf[i] + pe->b * yf[i] + pe->c;
+    }
+
+    if (ps->InterpolateW || ps->PVarCount > 0)
+    {
+        const ParameterEquation *pe = &eqn->invw;
+        for (int i = 0; i < n; ++i)
+        {
+            batch->invw[i] = pe->a * xf[i] + pe->b * yf[i] + pe->c;
+            batch->w[i] = 1.0f / batch->invw[i];
+        }
+    }
+
+    for (int v = 0; v < ps->AVarCount; ++v)
+    {
+        const ParameterEquation *pe = &eqn->avar[v];
+        for (int i = 0; i < n; ++i)
+            batch->avar[v][i] = pe->a * xf[i] + pe->b * yf[i] + pe->c;
+    }
+
+    for (int v = 0; v < ps->PVarCount; ++v)
+    {
+        const ParameterEquation *pe = &eqn->pvar[v];
+        for (int i = 0; i < n; ++i)
+            batch->pvar[v][i] = (pe->a * xf[i] + pe->b * yf[i] + pe->c) * batch->w[i];
+    }
+}
+
+// D32F targets store the interpolated z, which the batch only holds if the
+// shader interpolates it.
+static inline const OutputMerger *PixelShader_output(const PixelShader *ps, const OutputMerger *output)
+{
+    if (!ps->InterpolateZ && output->target && RenderTarget_format(output->target) == RTF_D32F)
+        return 0;
+    return output;
+}
+
+void PixelShader_drawBlockBatch(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, uint64_t mask)
+{
+    PixelBatch batch;
+    batch.count = PixelBatchSize;
+    batch.mask = mask;
+
+    for (int i = 0; i < PixelBatchSize; ++i)
+    {
+        batch.x[i] = x + i % BlockSize;
+        batch.y[i] = y + i / BlockSize;
+    }
+
+    PixelShader_interpolateBatch(ps, eqn, &batch);
+    ps->drawPixelBatch(&batch);
+
+    output = PixelShader_output(ps, output);
+    if (output)
+        OutputMerger_storeBlock(output, &batch, x, y);
+}
+
+void PixelShader_drawSpanBatch(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask)
+{
+    PixelBatch batch;
+    batch.count = count;
+    batch.mask = mask;
+
+    for (int i = 0; i < count; ++i)
+    {
+        batch.x[i] = x + i;
+        batch.y[i] = y;
+    }
+
+    PixelShader_interpolateBatch(ps, eqn, &batch);
+    ps->drawPixelBatch(&batch);
+
+    output = PixelShader_output(ps, output);
+    if (output)
+        OutputMerger_storeBatch(output, &batch);
+}
+
+void PixelData_avarDerivatives(const PixelData *p, int index, float *ddx, float *ddy)
+{
+    *ddx = p->equations ? p->equations->avar[index].a : 0.0f;
+    *ddy = p->equations ? p->equations->avar[index].b : 0.0f;
+}
+
+// pvar = pvarTemp / invw with both linear in x and y, so the derivative
+// is (d pvarTemp - pvar * d invw) * w.
+static inline void PixelShader_pvarDerivatives(const TriangleEquations *eqn, int index, float pvar, float w, float *ddx, float *ddy)
+{
+    if (!eqn)
+    {
+        *ddx = *ddy = 0.0f;
+        return;
+    }
+
+    *ddx = (eqn->pvar[index].a - pvar * eqn->invw.a) * w;
+    *ddy = (eqn->pvar[index].b - pvar * eqn->invw.b) * w;
+}
+
+void PixelData_pvarDerivatives(const PixelData *p, int index, float *ddx, float *ddy)
+{
+    PixelShader_pvarDerivatives(p->equations, index, p->pvar[index], p->w, ddx, ddy);
+}
+
+void PixelBatch_avarDerivatives(const PixelBatch *batch, int index, int lane, float *ddx, float *ddy)
+{
+    (void)lane;
+    *ddx = batch->equations ? batch->equations->avar[index].a : 0.0f;
+    *ddy = batch->equations ? batch->equations->avar[index].b : 0.0f;
+}
+
+void PixelBatch_pvarDerivatives(const PixelBatch *batch, int index, int lane, float *ddx, float *ddy)
+{
+    PixelShader_pvarDerivatives(batch->equations, index, batch->pvar[index][lane], batch->w[lane], ddx, ddy);
+}
@@ -29,6 +29,7 @@ SOFTWARE.
 #include "Renderer.h"
 #include "TriangleEquations.h"
 #include "PixelData.h"
+#include "RenderTarget.h"
 
 #include <stdbool.h>
 
@@ -50,14 +51,47 @@ typedef struct PixelShader_s {
 
     /// This performs the coloring and will be called for each pixel.
     DrawPixelCallback drawPixel;
+
+    /// Optional batch version of drawPixel called once per span or block.
+    DrawPixelBatchCallback drawPixelBatch;
+
+    /// Pixels between the exact perspective divisions of drawPixel. 0 divides at every pixel.
+    int PerspectiveStep;
+
+    /// Largest error of the perspective vars relative to their change over a step.
+    float PerspectiveMaxError;
+
+    /// Compute the exact divisions with a reciprocal estimate and a Newton-Raphson step.
+    int FastReciprocal;
+
+    /// Changes whenever a setting used to select the pixel loops changes.
+    unsigned Revision;
 } PixelShader;
 
-static const PixelShader PixelShader_default = { false, false, 0, 0, 0/*NULL*/};
+static const PixelShader PixelShader_default = { false, false, 0, 0, 0/*NULL*/, 0/*NULL*/, 0, 0.0f, false, 0 };
 
 void PixelShader_init(PixelShader *ps, int interpZ, int interpW, int affineCount, int perspCount, DrawPixelCallback callback);
-
-void PixelShader_drawBlock(PixelShader *ps, const TriangleEquations *eqn, int x, int y, bool testEdges);
-void PixelShader_drawSpan(PixelShader *ps, const TriangleEquations *eqn, int x, int y, int x2);
+void PixelShader_setDrawPixelBatch(PixelShader *ps, DrawPixelBatchCallback callback);
+void PixelShader_setPerspectiveStep(PixelShader *ps, int step, float maxError);
+void PixelShader_setFastReciprocal(PixelShader *ps, bool enable);
+/// Whether drawPixel gets subdivided perspective interpolation.
+static inline bool PixelShader_subdividePerspective(const PixelShader *ps)
+{
+    return ps->PerspectiveStep > 1 && ps->PVarCount > 0;
+}
+
+/// Draw the pixels of the block at (x, y) whose bits are set in the coverage mask.
+void PixelShader_drawBlock(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, uint64_t mask);
+void PixelShader_drawSpan(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int x2);
+/// Draw the pixels of the span of count <= PixelBatchSize pixels at (x, y) whose bits are set in the mask.
+void PixelShader_drawSpanMask(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask);
+/// Interpolate all the lanes of a batch whose coordinates are already set.
+void PixelShader_interpolateBatch(PixelShader *ps, const TriangleEquations *eqn, PixelBatch *batch);
+void PixelShader_drawBlockBatch(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, uint64_t mask);
+void PixelShader_drawSpanBatch(PixelShader *ps, const OutputMerger *output, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask);
+/// Draw count pixels starting at p with exact perspective values every PerspectiveStep pixels.
+/** p must hold the interpolated values of its first pixel except w and pvar. */
+void PixelShader_drawRowSubdivided(PixelShader *ps, const TriangleEquations *eqn, PixelData *p, int count, uint64_t mask);
 /// This is called per pixel. 
 /** Implement this in your derived class to display single pixels. */
 PixelData PixelShader_copyPixelData(PixelShader *ps, PixelData *po);
\ No newline at end of file
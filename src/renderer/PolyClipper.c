@@ -29,9 +29,9 @@ static inline int sgn(float val)
     return (0.f < val) - (val < 0.f);
 }
 
-void PolyClipper_init(PolyClipper *pc, Vector *vertices, int i1, int i2, int i3, int attribCount)
+void PolyClipper_init(PolyClipper *pc, Vector *vertices, int i1, int i2, int i3, int vertexSize)
 {
-	pc->m_attribCount = attribCount;
+	pc->m_vertexSize = vertexSize;
 	pc->m_vertices = vertices;
 
     Vector_clear(&pc->m_indicesIn);
@@ -52,7 +52,7 @@ void PolyClipper_clipToPlane(PolyClipper *pc, float a, float b, float c, float d
 	int idxPrev = Vector_element(&pc->m_indicesIn, 0, int);
 	Vector_append(&pc->m_indicesIn, idxPrev, int);
 
-	VertexShaderOutput *vPrev = &Vector_element(pc->m_vertices, idxPrev, VertexShaderOutput);
+	VertexShaderOutput *vPrev = Vector_at(pc->m_vertices, idxPrev);
 	float dpPrev = a * vPrev->x + b * vPrev->y + c * vPrev->z + d * vPrev->w;
 
     unsigned long indicesInSize = Vector_size(&pc->m_indicesIn);
@@ -60,7 +60,7 @@ void PolyClipper_clipToPlane(PolyClipper *pc, float a, float b, float c, float d
     for (unsigned long i = 1; i < indicesInSize; ++i)
 	{
 		int idx = Vector_element(&pc->m_indicesIn, i, int);
-		VertexShaderOutput *v = &Vector_element(pc->m_vertices, idx, VertexShaderOutput);
+		VertexShaderOutput *v = Vector_at(pc->m_vertices, idx);
 		float dp = a * v->x + b * v->y + c * v->z + d * v->w;
 
 		if (dpPrev >= 0)
@@ -70,12 +70,13 @@ void PolyClipper_clipToPlane(PolyClipper *pc, float a, float b, float c, float d
 		{
 			float t = dp < 0 ? dpPrev / (dpPrev - dp) : -dpPrev / (dp - dpPrev);
 
-            VertexShaderOutput *v0, *v1;
-            v0 = &Vector_element(pc->m_vertices, idxPrev, VertexShaderOutput);
-            v1 = &Vector_element(pc->m_vertices, idx, VertexShaderOutput);
-			VertexShaderOutput vOut = interpolateVertex(v0, v1, t, pc->m_attribCount);
-			Vector_append(pc->m_vertices, vOut, VertexShaderOutput);
-            int idxOut = Vector_size(pc->m_vertices) - 1;
+            int idxOut = Vector_size(pc->m_vertices);
+            Vector_set_size(pc->m_vertices, idxOut + 1);
+
+            // Fetch the pointers after the resize.
+            const float *v0 = Vector_at(pc->m_vertices, idxPrev);
+            const float *v1 = Vector_at(pc->m_vertices, idx);
+			interpolateVertex(Vector_at(pc->m_vertices, idxOut), v0, v1, t, pc->m_vertexSize);
 			Vector_append(&pc->m_indicesOut, idxOut, int);
 		}
 
@@ -30,7 +30,7 @@ SOFTWARE.
 #include <stdbool.h>
 
 typedef struct {
-	int m_attribCount;
+	int m_vertexSize;
 	Vector m_indicesIn;   // array
     Vector m_indicesOut;  // array
 	Vector *m_vertices; // array
@@ -48,7 +48,8 @@ static inline void PolyClipper_destruct(PolyClipper *pc)
     Vector_free(&pc->m_indicesOut);
 }
 
-void PolyClipper_init(PolyClipper *pc, Vector *vertices, int i1, int i2, int i3, int attribCount);
+/// vertices holds packed vertices of vertexSize floats each.
+void PolyClipper_init(PolyClipper *pc, Vector *vertices, int i1, int i2, int i3, int vertexSize);
 
 // Clip the poly to the plane given by the formula a * x + b * y + c * z + d * w.
 void PolyClipper_clipToPlane(PolyClipper *pc, float a, float b, float c, float d);
@@ -63,16 +64,9 @@ static inline bool PolyClipper_fullyClipped(PolyClipper *pc)
     return Vector_size(&pc->m_indicesIn) < 3;
 }
 
-static inline VertexShaderOutput interpolateVertex(const VertexShaderOutput *v0, const VertexShaderOutput *v1, float t, int attribCount)
+/// Interpolate all vertexSize floats of two packed vertices.
+static inline void interpolateVertex(float *result, const float *v0, const float *v1, float t, int vertexSize)
 {
-    VertexShaderOutput result;
-
-    result.x = v0->x * (1.0f - t) + v1->x * t;
-    result.y = v0->y * (1.0f - t) + v1->y * t;
-    result.z = v0->z * (1.0f - t) + v1->z * t;
-    result.w = v0->w * (1.0f - t) + v1->w * t;
-    for (int i = 0; i < attribCount; ++i)
-        result.avar[i] = v0->avar[i] * (1.0f - t) + v1->avar[i] * t;
-
-    return result;
+    for (int i = 0; i < vertexSize; ++i)
+        result[i] = v0[i] * (1.0f - t) + v1[i] * t;
 }
@@ -24,10 +24,59 @@ SOFTWARE.
 
 #include "Rasterizer.h"
 #include "EdgeEquation.h"
-#include "EdgeData.h"
+#include "Coverage.h"
+#include "JobSystem.h"
 
+#include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
-
+#include <string.h>
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+/// Smallest number of blocks, scanlines or tiles handed to a job.
+enum { BlockGrain = 16, ScanlineGrain = 16, TileGrain = 1 };
+
+/// Blocks per side of the coarse tiles classified before the blocks in block mode.
+enum { CoarseBlocks = TileSize / BlockSize };
+
+// State shared by the jobs of one triangle in block mode.
+typedef struct BlockJob {
+    Rasterizer *rs;
+    const TriangleEquations *eqn;
+    int minX, minY, stepsX, stepsY;
+    int coarseX;
+    uint64_t *masks;
+    volatile long covered;
+} BlockJob;
+
+// State shared by the jobs of one flat triangle in span mode.
+typedef struct SpanJob {
+    Rasterizer *rs;
+    SpanTriangle *tri;
+    // The scanline of row i is firstY + i * stepY. The edges are
+    // x = originX + invslope * (y - originY) with x1 <= x2.
+    int firstY, stepY;
+    float originX, originY;
+    float invslope1, invslope2;
+} SpanJob;
+
+// State of the tile jobs of a triangle list.
+typedef struct TileJob {
+    Rasterizer *rs;
+    int tileMinX, tileMinY, tilesX;
+} TileJob;
+
+// State of the jobs resolving the visibility buffer.
+typedef struct VisibilityJob {
+    Rasterizer *rs;
+} VisibilityJob;
 
 static inline void swap_ptrs(const void **ptr1, const void **ptr2)
 {
@@ -36,11 +85,93 @@ static inline void swap_ptrs(const void **ptr1, const void **ptr2)
     *ptr2 = tmp;
 }
 
+// Shade the pixels of mask in the block at (x, y), or only record the
+// triangle in them in the visibility buffer mode.
+static inline void Rasterizer_shadeBlock(Rasterizer *rs, const TriangleEquations *eqn, int x, int y, uint64_t mask)
+{
+    if (rs->m_visibility)
+        VisibilityBuffer_writeBlock(&rs->m_visibilityBuffer, x, y, mask, eqn->id);
+    else
+        rs->m_kernels.drawBlock(rs->m_pixelShader, &rs->m_output, eqn, x, y, mask);
+}
+
+// Span version of Rasterizer_shadeBlock.
+static inline void Rasterizer_shadeSpan(Rasterizer *rs, const TriangleEquations *eqn, int x, int y, int count, uint64_t mask)
+{
+    if (rs->m_visibility)
+        VisibilityBuffer_writeSpan(&rs->m_visibilityBuffer, x, y, count, mask, eqn->id);
+    else
+        rs->m_kernels.drawSpanMask(rs->m_pixelShader, &rs->m_output, eqn, x, y, count, mask);
+}
+
 void Rasterizer_construct(Rasterizer *rs)
 {
+    Coverage_init();
+
+    Vector_init(&rs->m_binnedTriangles, sizeof(BinnedTriangle));
+    Vector_init(&rs->m_tileOffsets, sizeof(int));
+    Vector_init(&rs->m_tileTriangles, sizeof(int));
+    Vector_init(&rs->m_blockMasks, sizeof(uint64_t));
+    Vector_init(&rs->m_visibilityDraws, sizeof(VisibilityDraw));
+    Vector_init(&rs->m_visibilityTriangles, sizeof(VisibilityTriangle));
+    Vector_init(&rs->m_visibilityPrimitives, sizeof(VisibilityPrimitive));
+    Vector_init(&rs->m_visibilityVertices, 1);
+
+    rs->m_depthTest = false;
+    DepthBuffer_construct(&rs->m_depthBuffer);
+
+    rs->m_visibility = false;
+    rs->m_visibilityLock = 0;
+    VisibilityBuffer_construct(&rs->m_visibilityBuffer);
+
     Rasterizer_setRasterMode(rs, RM_Span);
+    Rasterizer_setFixedPoint(rs, false);
     Rasterizer_setScissorRect(rs, 0, 0, 0, 0);
     Rasterizer_setPixelShader(rs, 0);
+    Rasterizer_setRenderTarget(rs, 0);
+    Rasterizer_setBlendMode(rs, BM_Opaque);
+    Rasterizer_setColorWriteMask(rs, CWM_All);
+    Rasterizer_setDefaultVertexLayout(rs);
+}
+
+void Rasterizer_setVertexLayout(Rasterizer *rs, int stride, int pvarOffset)
+{
+    rs->m_vertexStride = stride;
+    rs->m_pvarOffset = pvarOffset;
+}
+
+void Rasterizer_setDefaultVertexLayout(Rasterizer *rs)
+{
+    Rasterizer_setVertexLayout(rs, sizeof(RasterizerVertex), offsetof(RasterizerVertex, pvar) / sizeof(float));
+}
+
+void Rasterizer_setRenderTarget(Rasterizer *rs, RenderTarget *rt)
+{
+    rs->m_output.target = rt;
+}
+
+void Rasterizer_setBlendMode(Rasterizer *rs, BlendMode mode)
+{
+    rs->m_output.blendMode = mode;
+}
+
+void Rasterizer_setColorWriteMask(Rasterizer *rs, int mask)
+{
+    rs->m_output.colorWriteMask = mask & CWM_All;
+}
+
+void Rasterizer_destruct(Rasterizer *rs)
+{
+    Vector_free(&rs->m_binnedTriangles);
+    Vector_free(&rs->m_tileOffsets);
+    Vector_free(&rs->m_tileTriangles);
+    Vector_free(&rs->m_blockMasks);
+    Vector_free(&rs->m_visibilityDraws);
+    Vector_free(&rs->m_visibilityTriangles);
+    Vector_free(&rs->m_visibilityPrimitives);
+    Vector_free(&rs->m_visibilityVertices);
+    DepthBuffer_destruct(&rs->m_depthBuffer);
+    VisibilityBuffer_destruct(&rs->m_visibilityBuffer);
 }
 
 void Rasterizer_setRasterMode(Rasterizer *rs, RasterMode mode)
@@ -48,6 +179,11 @@ void Rasterizer_setRasterMode(Rasterizer *rs, RasterMode mode)
     rs->rasterMode = mode;
 }
 
+void Rasterizer_setFixedPoint(Rasterizer *rs, bool enable)
+{
+    rs->m_fixedPoint = enable;
+}
+
 /// Set the scissor rectangle.
 void Rasterizer_setScissorRect(Rasterizer *rs, int x, int y, int width, int height)
 {
@@ -55,28 +191,70 @@ void Rasterizer_setScissorRect(Rasterizer *rs, int x, int y, int width, int heig
     rs->m_minY = y;
     rs->m_maxX = x + width;
     rs->m_maxY = y + height;
+
+    if (rs->m_depthTest)
+        DepthBuffer_reserve(&rs->m_depthBuffer, rs->m_maxX, rs->m_maxY);
+    if (rs->m_visibility)
+        VisibilityBuffer_reserve(&rs->m_visibilityBuffer, rs->m_maxX, rs->m_maxY);
+}
+
+void Rasterizer_setDepthTest(Rasterizer *rs, bool enable)
+{
+    rs->m_depthTest = enable;
+
+    if (rs->m_depthTest)
+        DepthBuffer_reserve(&rs->m_depthBuffer, rs->m_maxX, rs->m_maxY);
+}
+
+void Rasterizer_clearDepth(Rasterizer *rs, float depth)
+{
+    DepthBuffer_reserve(&rs->m_depthBuffer, rs->m_maxX, rs->m_maxY);
+    DepthBuffer_clear(&rs->m_depthBuffer, depth);
+}
+
+void Rasterizer_setVisibilityMode(Rasterizer *rs, bool enable)
+{
+    rs->m_visibility = enable;
+
+    if (rs->m_visibility)
+        VisibilityBuffer_reserve(&rs->m_visibilityBuffer, rs->m_maxX, rs->m_maxY);
 }
 
 void Rasterizer_setPixelShader(Rasterizer *rs, PixelShader *ps)
 {
     rs->m_pixelShader = ps;
+    rs->m_kernels = PixelKernels_select(ps);
+    rs->m_kernelsRevision = ps ? ps->Revision : 0;
     rs->m_triangleFunc = Rasterizer_drawTriangleModeTemplate;
     rs->m_lineFunc = Rasterizer_drawLineTemplate;
     rs->m_pointFunc = Rasterizer_drawPointTemplate;
 }
 
+// Select the pixel loops again if the pixel shader settings changed since.
+static inline void Rasterizer_updateKernels(Rasterizer *rs)
+{
+    if (rs->m_pixelShader && rs->m_pixelShader->Revision != rs->m_kernelsRevision)
+    {
+        rs->m_kernels = PixelKernels_select(rs->m_pixelShader);
+        rs->m_kernelsRevision = rs->m_pixelShader->Revision;
+    }
+}
+
 void Rasterizer_drawPoint(Rasterizer *rs, const RasterizerVertex *v)
 {
+    Rasterizer_updateKernels(rs);
     (*rs->m_pointFunc)(rs, v);
 }
 
 void Rasterizer_drawLine(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1)
 {
+    Rasterizer_updateKernels(rs);
     (*rs->m_lineFunc)(rs, v0, v1);
 }
 
 void Rasterizer_drawTriangle(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
+    Rasterizer_updateKernels(rs);
     (*rs->m_triangleFunc)(rs, v0, v1, v2);
 }
 
@@ -85,7 +263,7 @@ void Rasterizer_drawPointList(Rasterizer *rs, const RasterizerVertex *vertices,
     for (unsigned long i = 0; i < indexCount; ++i) {
         if (indices[i] == -1)
             continue;
-        Rasterizer_drawPoint(rs, &vertices[indices[i]]);
+        Rasterizer_drawPoint(rs, Rasterizer_vertex(rs, vertices, indices[i]));
     }
 }
 
@@ -94,16 +272,23 @@ void Rasterizer_drawLineList(Rasterizer *rs, const RasterizerVertex *vertices, c
     for (unsigned long i = 0; i + 2 <= indexCount; i += 2) {
         if (indices[i] == -1)
             continue;
-        Rasterizer_drawLine(rs, &vertices[indices[i]], &vertices[indices[i + 1]]);
+        Rasterizer_drawLine(rs, Rasterizer_vertex(rs, vertices, indices[i]), Rasterizer_vertex(rs, vertices, indices[i + 1]));
     }
 }
 
 void Rasterizer_drawTriangleList(Rasterizer *rs, const RasterizerVertex *vertices, const int *indices, unsigned long indexCount)
 {
+    if (rs->rasterMode == RM_Tiled)
+    {
+        Rasterizer_updateKernels(rs);
+        Rasterizer_drawTriangleListTiled(rs, vertices, indices, indexCount);
+        return;
+    }
+
     for (unsigned long i = 0; i + 3 <= indexCount; i += 3) {
         if (indices[i] == -1)
             continue;
-        Rasterizer_drawTriangle(rs, &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]]);
+        Rasterizer_drawTriangle(rs, Rasterizer_vertex(rs, vertices, indices[i]), Rasterizer_vertex(rs, vertices, indices[i + 1]), Rasterizer_vertex(rs, vertices, indices[i + 2]));
     }
 }
 
@@ -114,6 +299,12 @@ bool Rasterizer_scissorTest(Rasterizer *rs, float x, float y)
 
 void Rasterizer_drawPointTemplate(Rasterizer *rs, const RasterizerVertex *v)
 {
+    if (rs->m_visibility)
+    {
+        Rasterizer_recordPrimitive(rs, v, 0);
+        return;
+    }
+
     // Check scissor rect
     if (!Rasterizer_scissorTest(rs, v->x, v->y))
         return;
@@ -128,6 +319,7 @@ PixelData Rasterizer_pixelDataFromVertex(Rasterizer *rs, const RasterizerVertex
     PixelData p;
     p.x = (int)v->x;
     p.y = (int)v->y;
+    p.equations = 0;
     if (rs->m_pixelShader->InterpolateZ) p.z = v->z;
     if (rs->m_pixelShader->InterpolateW) p.invw = 1.0f / v->w;
     for (int i = 0; i < rs->m_pixelShader->AVarCount; ++i)
@@ -137,13 +329,20 @@ PixelData Rasterizer_pixelDataFromVertex(Rasterizer *rs, const RasterizerVertex
 
 void Rasterizer_drawLineTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1)
 {
+    if (rs->m_visibility)
+    {
+        Rasterizer_recordPrimitive(rs, v0, v1);
+        return;
+    }
+
     int adx = abs((int)v1->x - (int)v0->x);
     int ady = abs((int)v1->y - (int)v0->y);
     int steps = max(adx, ady);
 
     RasterizerVertex step = Rasterizer_computeVertexStep(rs, v0, v1, steps);
 
-    RasterizerVertex v = *v0;
+    RasterizerVertex v;
+    memcpy(&v, v0, rs->m_vertexStride);
     while (steps-- > 0)
     {
         PixelData p = Rasterizer_pixelDataFromVertex(rs, &v);
@@ -178,14 +377,188 @@ RasterizerVertex Rasterizer_computeVertexStep(Rasterizer *rs, const RasterizerVe
     return step;
 }
 
+bool Rasterizer_setupTriangle(Rasterizer *rs, TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+{
+    // The snapped triangle decides about culling in fixed point mode.
+    if (rs->m_fixedPoint && !TriangleEquations_constructFixed(eqn, v0, v1, v2))
+        return false;
+
+    TriangleEquations_constructEdges(eqn, v0, v1, v2);
+
+    // Check if triangle is backfacing.
+    if (eqn->area2 <= 0)
+        return false;
+
+    // Hierarchical and per pixel depth tests run before the parameter setup.
+    if (rs->m_depthTest)
+        TriangleEquations_constructDepth(eqn, v0, v1, v2);
+
+    return true;
+}
+
+void Rasterizer_setupParams(Rasterizer *rs, TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+{
+    const PixelShader *ps = rs->m_pixelShader;
+
+    // In the visibility buffer mode the parameters are only set up when
+    // resolving. Record the triangle now that it is known to cover a pixel.
+    if (rs->m_visibility)
+    {
+        eqn->id = Rasterizer_recordTriangle(rs, v0, v1, v2);
+        return;
+    }
+
+    if (ps->InterpolateZ && !rs->m_depthTest)
+        TriangleEquations_constructDepth(eqn, v0, v1, v2);
+
+    TriangleEquations_constructParams(eqn, v0, v1, v2, ps->InterpolateW, ps->AVarCount, ps->PVarCount, rs->m_pvarOffset);
+}
+
+static int clampToInt(float v, int lo, int hi)
+{
+    if (!(v > (float)lo)) return lo;
+    if (!(v < (float)hi)) return hi;
+    return (int)v;
+}
+
+bool Rasterizer_sampleBounds(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, int *x0, int *y0, int *x1, int *y1)
+{
+    // Snapping may move the vertices by up to half a sub-pixel.
+    float eps = rs->m_fixedPoint ? 1.0f / SubPixelScale : 0.0f;
+
+    float minX = min(min(v0->x, v1->x), v2->x) - eps;
+    float maxX = max(max(v0->x, v1->x), v2->x) + eps;
+    float minY = min(min(v0->y, v1->y), v2->y) - eps;
+    float maxY = max(max(v0->y, v1->y), v2->y) + eps;
+
+    // Pixel x is sampled at x + 0.5. The bounds are clamped before the
+    // conversion since unclipped vertices may lie outside the int range.
+    *x0 = clampToInt(ceilf(minX - 0.5f), rs->m_minX, rs->m_maxX);
+    *x1 = clampToInt(floorf(maxX - 0.5f), rs->m_minX - 1, rs->m_maxX - 1);
+    *y0 = clampToInt(ceilf(minY - 0.5f), rs->m_minY, rs->m_maxY);
+    *y1 = clampToInt(floorf(maxY - 0.5f), rs->m_minY - 1, rs->m_maxY - 1);
+
+    return *x0 <= *x1 && *y0 <= *y1;
+}
+
+void Rasterizer_drawMicroTriangle(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, int x, int y, int w, int h)
+{
+    TriangleEquations eqn;
+    if (!Rasterizer_setupTriangle(rs, &eqn, v0, v1, v2))
+        return;
+
+    uint64_t mask = Coverage_rectMask(&eqn, x, y, w, h, rs->m_fixedPoint);
+    if (!mask)
+        return;
+
+    uint64_t rowMasks[MicroTriangleSize];
+    uint64_t covered = 0;
+
+    for (int yy = 0; yy < h; ++yy)
+    {
+        rowMasks[yy] = (mask >> (yy * BlockSize)) & ((1 << w) - 1);
+
+        if (rs->m_depthTest && rowMasks[yy])
+            rowMasks[yy] = DepthBuffer_testSpan(&rs->m_depthBuffer, &eqn, x, y + yy, w, rowMasks[yy]);
+
+        covered |= rowMasks[yy];
+    }
+
+    if (!covered)
+        return;
+
+    Rasterizer_setupParams(rs, &eqn, v0, v1, v2);
+
+    for (int yy = 0; yy < h; ++yy)
+        if (rowMasks[yy])
+            Rasterizer_shadeSpan(rs, &eqn, x, y + yy, w, rowMasks[yy]);
+}
+
+uint64_t Rasterizer_scissorMask(Rasterizer *rs, int x, int y)
+{
+    if (x >= rs->m_minX && x + BlockSize <= rs->m_maxX && y >= rs->m_minY && y + BlockSize <= rs->m_maxY)
+        return ~(uint64_t)0;
+
+    uint64_t rowMask = 0;
+    for (int xx = 0; xx < BlockSize; ++xx)
+        if (x + xx >= rs->m_minX && x + xx < rs->m_maxX)
+            rowMask |= (uint64_t)1 << xx;
+
+    uint64_t mask = 0;
+    for (int yy = 0; yy < BlockSize; ++yy)
+        if (y + yy >= rs->m_minY && y + yy < rs->m_maxY)
+            mask |= rowMask << (yy * BlockSize);
+
+    return mask;
+}
+
+// Compute the mask of the pixels of the block that pass the scissor, coverage and depth tests.
+// The coverage test is skipped for blocks known to be inside the triangle.
+uint64_t Rasterizer_triangleBlockMask(Rasterizer *rs, const TriangleEquations *eqn, int x, int y, bool inside)
+{
+    uint64_t mask = Rasterizer_scissorMask(rs, x, y);
+    if (!mask)
+        return 0;
+
+    // Reject the whole block before any pixel is touched.
+    if (rs->m_depthTest && DepthBuffer_rejectBlock(&rs->m_depthBuffer, eqn, x, y))
+        return 0;
+
+    if (!inside)
+        mask &= rs->m_fixedPoint ? Coverage_blockMaskFixed(eqn, x, y) : Coverage_blockMask(eqn, x, y);
+
+    if (rs->m_depthTest && mask)
+        mask = DepthBuffer_testBlock(&rs->m_depthBuffer, eqn, x, y, mask);
+
+    return mask;
+}
+
+void Rasterizer_drawSpan(Rasterizer *rs, SpanTriangle *tri, int x, int y, int x2)
+{
+    if (y < rs->m_minY || y >= rs->m_maxY)
+        return;
+
+    const TriangleEquations *eqn = &tri->eqn;
+
+    while (x < x2)
+    {
+        int n = x2 - x < PixelBatchSize ? x2 - x : PixelBatchSize;
+        uint64_t mask = n == PixelBatchSize ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+
+        if (rs->m_depthTest)
+            mask = DepthBuffer_testSpan(&rs->m_depthBuffer, eqn, x, y, n, mask);
+        if (mask)
+        {
+            Rasterizer_setupSpanParams(rs, tri);
+            Rasterizer_shadeSpan(rs, eqn, x, y, n, mask);
+        }
+
+        x += n;
+    }
+}
+
+void Rasterizer_setupSpanParams(Rasterizer *rs, SpanTriangle *tri)
+{
+    if (Atomic_load(&tri->state) == 2)
+        return;
+
+    if (Atomic_compareExchange(&tri->state, 0, 1))
+    {
+        Rasterizer_setupParams(rs, &tri->eqn, tri->v0, tri->v1, tri->v2);
+        Atomic_store(&tri->state, 2);
+        return;
+    }
+
+    // Another span job is setting up the parameters.
+    while (Atomic_load(&tri->state) != 2)
+        ;
+}
+
 void Rasterizer_drawTriangleBlockTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
     // Compute triangle equations.
     TriangleEquations eqn;
-    TriangleEquations_construct(&eqn, v0, v1, v2, rs->m_pixelShader->AVarCount, rs->m_pixelShader->PVarCount);
-
-    // Check if triangle is backfacing.
-    if (eqn.area2 <= 0)
+    if (!Rasterizer_setupTriangle(rs, &eqn, v0, v1, v2))
         return;
 
     // Compute triangle bounding box.
@@ -206,73 +579,95 @@ void Rasterizer_drawTriangleBlockTemplate(Rasterizer *rs, const RasterizerVertex
     minY = minY & ~(BlockSize - 1);
     maxY = maxY & ~(BlockSize - 1);
 
-    float s = BlockSize - 1;
-
     int stepsX = (maxX - minX) / BlockSize + 1;
     int stepsY = (maxY - minY) / BlockSize + 1;
 
-    int i;
-#pragma omp parallel for
-    for (i = 0; i < stepsX * stepsY; ++i)
-    {
-        int sx = i % stepsX;
-        int sy = i / stepsX;
+    int coarseX = (stepsX + CoarseBlocks - 1) / CoarseBlocks;
+    int coarseY = (stepsY + CoarseBlocks - 1) / CoarseBlocks;
 
-        // Add 0.5 to sample at pixel centers.
-        int x = minX + sx * BlockSize;
-        int y = minY + sy * BlockSize;
+    Vector_set_size(&rs->m_blockMasks, stepsX * stepsY);
+    BlockJob job = { rs, &eqn, minX, minY, stepsX, stepsY, coarseX, rs->m_blockMasks.data, 0 };
 
-        float xf = x + 0.5f;
-        float yf = y + 0.5f;
+    // First pass: coverage and depth only, one coarse tile per item.
+    JobSystem_parallelFor(coarseX * coarseY, 1, Rasterizer_blockMaskJob, &job);
 
-        // Test if block is inside or outside triangle or touches it.
-        EdgeData e00; EdgeData_init(&e00, &eqn, xf, yf);
-        EdgeData e01 = e00; EdgeData_stepY2(&e01, &eqn, s);
-        EdgeData e10 = e00; EdgeData_stepX2(&e10, &eqn, s);
-        EdgeData e11 = e01; EdgeData_stepX2(&e11, &eqn, s);
+    if (!job.covered)
+        return;
 
-        bool e00_0 = EdgeEquation_testValue(&eqn.e0, e00.ev0), e00_1 = EdgeEquation_testValue(&eqn.e1, e00.ev1), e00_2 = EdgeEquation_testValue(&eqn.e2, e00.ev2), e00_all = e00_0 && e00_1 && e00_2;
-        bool e01_0 = EdgeEquation_testValue(&eqn.e0, e01.ev0), e01_1 = EdgeEquation_testValue(&eqn.e1, e01.ev1), e01_2 = EdgeEquation_testValue(&eqn.e2, e01.ev2), e01_all = e01_0 && e01_1 && e01_2;
-        bool e10_0 = EdgeEquation_testValue(&eqn.e0, e10.ev0), e10_1 = EdgeEquation_testValue(&eqn.e1, e10.ev1), e10_2 = EdgeEquation_testValue(&eqn.e2, e10.ev2), e10_all = e10_0 && e10_1 && e10_2;
-        bool e11_0 = EdgeEquation_testValue(&eqn.e0, e11.ev0), e11_1 = EdgeEquation_testValue(&eqn.e1, e11.ev1), e11_2 = EdgeEquation_testValue(&eqn.e2, e11.ev2), e11_all = e11_0 && e11_1 && e11_2;
+    // Second pass: shade the covered blocks.
+    Rasterizer_setupParams(rs, &eqn, v0, v1, v2);
 
-        int result = e00_all + e01_all + e10_all + e11_all;
+    JobSystem_parallelFor(stepsX * stepsY, BlockGrain, Rasterizer_blockShadeJob, &job);
+}
 
-        // Potentially all out.
-        if (result == 0)
-        {
-            // Test for special case.
-            bool e00Same = e00_0 == e00_1 == e00_2;
-            bool e01Same = e01_0 == e01_1 == e01_2;
-            bool e10Same = e10_0 == e10_1 == e10_2;
-            bool e11Same = e11_0 == e11_1 == e11_2;
-
-            if (!e00Same || !e01Same || !e10Same || !e11Same)
-                PixelShader_drawBlock(rs->m_pixelShader, &eqn, x, y, true);
-        }
-        else if (result == 4)
-        {
-            // Fully Covered.
-            PixelShader_drawBlock(rs->m_pixelShader, &eqn, x, y, false);
-        }
-        else
-        {
-            // Partially Covered.
-            PixelShader_drawBlock(rs->m_pixelShader, &eqn, x, y, true);
-        }
+void Rasterizer_blockMaskJob(void *data, int begin, int end)
+{
+    BlockJob *job = data;
+    uint64_t covered = 0;
+
+    for (int i = begin; i < end; ++i)
+    {
+        int sx0 = i % job->coarseX * CoarseBlocks;
+        int sy0 = i / job->coarseX * CoarseBlocks;
+        int sx1 = min(sx0 + CoarseBlocks, job->stepsX);
+        int sy1 = min(sy0 + CoarseBlocks, job->stepsY);
+
+        // Skip the tiles outside the triangle and the edge tests of the tiles inside it.
+        CoverageClass cc = Coverage_classifyRect(job->eqn, job->minX + sx0 * BlockSize, job->minY + sy0 * BlockSize,
+            (sx1 - sx0) * BlockSize, (sy1 - sy0) * BlockSize, job->rs->m_fixedPoint);
+
+        for (int sy = sy0; sy < sy1; ++sy)
+            for (int sx = sx0; sx < sx1; ++sx)
+            {
+                uint64_t *mask = &job->masks[sy * job->stepsX + sx];
+
+                *mask = cc == CC_Outside ? 0 :
+                    Rasterizer_triangleBlockMask(job->rs, job->eqn, job->minX + sx * BlockSize, job->minY + sy * BlockSize, cc == CC_Inside);
+                covered |= *mask;
+            }
+    }
+
+    if (covered)
+        Atomic_store(&job->covered, 1);
+}
+
+void Rasterizer_blockShadeJob(void *data, int begin, int end)
+{
+    BlockJob *job = data;
+    Rasterizer *rs = job->rs;
+
+    for (int i = begin; i < end; ++i)
+    {
+        if (!job->masks[i])
+            continue;
+
+        int sx = i % job->stepsX;
+        int sy = i / job->stepsX;
+
+        Rasterizer_shadeBlock(rs, job->eqn, job->minX + sx * BlockSize, job->minY + sy * BlockSize, job->masks[i]);
     }
 }
 
 void Rasterizer_drawTriangleSpanTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
     // Compute triangle equations.
-    TriangleEquations eqn;
-    TriangleEquations_construct(&eqn, v0, v1, v2, rs->m_pixelShader->AVarCount, rs->m_pixelShader->PVarCount);
+    SpanTriangle tri;
+    TriangleEquations *eqn = &tri.eqn;
+    TriangleEquations_constructEdges(eqn, v0, v1, v2);
 
     // Check if triangle is backfacing.
-    if (eqn.area2 <= 0)
+    if (eqn->area2 <= 0)
         return;
 
+    if (rs->m_depthTest)
+        TriangleEquations_constructDepth(eqn, v0, v1, v2);
+
+    // The parameters are set up by the first span with a visible pixel.
+    tri.v0 = v0;
+    tri.v1 = v1;
+    tri.v2 = v2;
+    tri.state = 0;
+
     const RasterizerVertex *t = v0;
     const RasterizerVertex *m = v1;
     const RasterizerVertex *b = v2;
@@ -289,13 +684,13 @@ void Rasterizer_drawTriangleSpanTemplate(Rasterizer *rs, const RasterizerVertex
     {
         const RasterizerVertex *l = m, *r = t;
         if (l->x > r->x) swap_ptrs(&l, &r);
-        Rasterizer_drawTopFlatTriangle(rs, &eqn, l, r, b);
+        Rasterizer_drawTopFlatTriangle(rs, &tri, l, r, b);
     }
     else if (m->y == b->y)
     {
         const RasterizerVertex *l = m, *r = b;
         if (l->x > r->x) swap_ptrs(&l, &r);
-        Rasterizer_drawBottomFlatTriangle(rs, &eqn, t, l, r);
+        Rasterizer_drawBottomFlatTriangle(rs, &tri, t, l, r);
     }
     else
     {
@@ -310,12 +705,12 @@ void Rasterizer_drawTriangleSpanTemplate(Rasterizer *rs, const RasterizerVertex
         const RasterizerVertex *l = m, *r = &v4;
         if (l->x > r->x) swap_ptrs(&l, &r);
 
-        Rasterizer_drawBottomFlatTriangle(rs, &eqn, t, l, r);
-        Rasterizer_drawTopFlatTriangle(rs, &eqn, l, r, b);
+        Rasterizer_drawBottomFlatTriangle(rs, &tri, t, l, r);
+        Rasterizer_drawTopFlatTriangle(rs, &tri, l, r, b);
     }
 }
 
-void Rasterizer_drawBottomFlatTriangle(Rasterizer *rs, const TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+void Rasterizer_drawBottomFlatTriangle(Rasterizer *rs, SpanTriangle *tri, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
     float invslope1 = (v1->x - v0->x) / (v1->y - v0->y);
     float invslope2 = (v2->x - v0->x) / (v2->y - v0->y);
@@ -323,26 +718,15 @@ void Rasterizer_drawBottomFlatTriangle(Rasterizer *rs, const TriangleEquations *
     //float curx1 = v0.x;
     //float curx2 = v0.x;
 
-    int scanlineY;
-#pragma omp parallel for
-    for (scanlineY = (int)(v0->y + 0.5f); scanlineY < (int)(v1->y + 0.5f); scanlineY++)
-    {
-        float dy = (scanlineY - v0->y) + 0.5f;
-        float curx1 = v0->x + invslope1 * dy + 0.5f;
-        float curx2 = v0->x + invslope2 * dy + 0.5f;
-
-        // Clip to scissor rect
-        int xl = max(rs->m_minX, (int)curx1);
-        int xr = min(rs->m_maxX, (int)curx2);
-
-        PixelShader_drawSpan(rs->m_pixelShader, eqn, xl, scanlineY, xr);
+    // Only walk the scanlines inside the scissor rect.
+    int firstY = max((int)(v0->y + 0.5f), rs->m_minY);
+    int endY = min((int)(v1->y + 0.5f), rs->m_maxY);
 
-        // curx1 += invslope1;
-        // curx2 += invslope2;
-    }
+    SpanJob job = { rs, tri, firstY, 1, v0->x, v0->y, invslope1, invslope2 };
+    JobSystem_parallelFor(endY - firstY, ScanlineGrain, Rasterizer_spanJob, &job);
 }
 
-void Rasterizer_drawTopFlatTriangle(Rasterizer *rs, const TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+void Rasterizer_drawTopFlatTriangle(Rasterizer *rs, SpanTriangle *tri, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
     float invslope1 = (v2->x - v0->x) / (v2->y - v0->y);
     float invslope2 = (v2->x - v1->x) / (v2->y - v1->y);
@@ -350,21 +734,32 @@ void Rasterizer_drawTopFlatTriangle(Rasterizer *rs, const TriangleEquations *eqn
     // float curx1 = v2.x;
     // float curx2 = v2.x;
 
-    int scanlineY;
-#pragma omp parallel for
-    for (scanlineY = (int)(v2->y - 0.5f); scanlineY > (int)(v0->y - 0.5f); scanlineY--)
+    // Only walk the scanlines inside the scissor rect.
+    int firstY = min((int)(v2->y - 0.5f), rs->m_maxY - 1);
+    int endY = max((int)(v0->y - 0.5f), rs->m_minY - 1);
+
+    SpanJob job = { rs, tri, firstY, -1, v2->x, v2->y, invslope1, invslope2 };
+    JobSystem_parallelFor(firstY - endY, ScanlineGrain, Rasterizer_spanJob, &job);
+}
+
+void Rasterizer_spanJob(void *data, int begin, int end)
+{
+    const SpanJob *job = data;
+    Rasterizer *rs = job->rs;
+
+    for (int i = begin; i < end; ++i)
     {
-        float dy = (scanlineY - v2->y) + 0.5f;
-        float curx1 = v2->x + invslope1 * dy + 0.5f;
-        float curx2 = v2->x + invslope2 * dy + 0.5f;
+        int scanlineY = job->firstY + i * job->stepY;
+
+        float dy = (scanlineY - job->originY) + 0.5f;
+        float curx1 = job->originX + job->invslope1 * dy + 0.5f;
+        float curx2 = job->originX + job->invslope2 * dy + 0.5f;
 
         // Clip to scissor rect
         int xl = max(rs->m_minX, (int)curx1);
         int xr = min(rs->m_maxX, (int)curx2);
 
-        PixelShader_drawSpan(rs->m_pixelShader, eqn, xl, scanlineY, xr);
-        // curx1 -= invslope1;
-        // curx2 -= invslope2;
+        Rasterizer_drawSpan(rs, job->tri, xl, scanlineY, xr);
     }
 }
 
@@ -378,7 +773,8 @@ void Rasterizer_drawTriangleAdaptiveTemplate(Rasterizer *rs, const RasterizerVer
 
     float orient = (maxX - minX) / (maxY - minY);
 
-    if (orient > 0.4 && orient < 1.6)
+    // Fixed point edges are only watertight if every triangle uses them.
+    if (rs->m_fixedPoint || (orient > 0.4 && orient < 1.6))
         Rasterizer_drawTriangleBlockTemplate(rs, v0, v1, v2);
     else
         Rasterizer_drawTriangleSpanTemplate(rs, v0, v1, v2);
@@ -386,6 +782,20 @@ void Rasterizer_drawTriangleAdaptiveTemplate(Rasterizer *rs, const RasterizerVer
 
 void Rasterizer_drawTriangleModeTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
+    // Drop triangles that can not cover any pixel center.
+    int x0, y0, x1, y1;
+    if (!Rasterizer_sampleBounds(rs, v0, v1, v2, &x0, &y0, &x1, &y1))
+        return;
+
+    // The micro path uses the edge function fill rule of the block modes.
+    // Span mode keeps its scanline rule for all triangles, otherwise edges
+    // shared with larger triangles could be missed or covered twice.
+    if (rs->rasterMode != RM_Span && x1 - x0 < MicroTriangleSize && y1 - y0 < MicroTriangleSize)
+    {
+        Rasterizer_drawMicroTriangle(rs, v0, v1, v2, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+        return;
+    }
+
     switch (rs->rasterMode)
     {
     case RM_Span:
@@ -397,5 +807,354 @@ void Rasterizer_drawTriangleModeTemplate(Rasterizer *rs, const RasterizerVertex
     case RM_Adaptive:
         Rasterizer_drawTriangleAdaptiveTemplate(rs, v0, v1, v2);
         break;
+    case RM_Tiled:
+        // Single triangles are not worth binning.
+        Rasterizer_drawTriangleBlockTemplate(rs, v0, v1, v2);
+        break;
+    }
+}
+
+void Rasterizer_drawTriangleListTiled(Rasterizer *rs, const RasterizerVertex *vertices, const int *indices, unsigned long indexCount)
+{
+    if (rs->m_minX >= rs->m_maxX || rs->m_minY >= rs->m_maxY)
+        return;
+
+    // Tile grid covering the scissor rect.
+    int tileMinX = rs->m_minX / TileSize;
+    int tileMinY = rs->m_minY / TileSize;
+    int tilesX = (rs->m_maxX - 1) / TileSize - tileMinX + 1;
+    int tilesY = (rs->m_maxY - 1) / TileSize - tileMinY + 1;
+    int tileCount = tilesX * tilesY;
+
+    Vector_clear(&rs->m_binnedTriangles);
+    Vector_clear(&rs->m_tileOffsets);
+    Vector_set_size(&rs->m_tileOffsets, tileCount + 1);
+    int *offsets = rs->m_tileOffsets.data;
+    for (int t = 0; t <= tileCount; ++t)
+        offsets[t] = 0;
+
+    // Set up all triangles once and count how many of them touch each tile.
+    for (unsigned long i = 0; i + 3 <= indexCount; i += 3)
+    {
+        if (indices[i] == -1)
+            continue;
+
+        const RasterizerVertex *v0 = Rasterizer_vertex(rs, vertices, indices[i]);
+        const RasterizerVertex *v1 = Rasterizer_vertex(rs, vertices, indices[i + 1]);
+        const RasterizerVertex *v2 = Rasterizer_vertex(rs, vertices, indices[i + 2]);
+
+        // Pixels whose centers are in the bounding box clipped to the scissor rect.
+        BinnedTriangle tri;
+        if (!Rasterizer_sampleBounds(rs, v0, v1, v2, &tri.minX, &tri.minY, &tri.maxX, &tri.maxY))
+            continue;
+
+        if (!Rasterizer_setupTriangle(rs, &tri.eqn, v0, v1, v2))
+            continue;
+
+        tri.v0 = v0;
+        tri.v1 = v1;
+        tri.v2 = v2;
+        tri.paramsReady = false;
+        tri.recorded = 0;
+
+        // A triangle in a single tile is only seen by one thread and can
+        // set up its parameters once it is found to cover a pixel.
+        // The visibility buffer mode records all triangles on first use.
+        if (!rs->m_visibility && (tri.minX / TileSize != tri.maxX / TileSize || tri.minY / TileSize != tri.maxY / TileSize))
+        {
+            Rasterizer_setupParams(rs, &tri.eqn, v0, v1, v2);
+            tri.paramsReady = true;
+        }
+
+        Vector_append(&rs->m_binnedTriangles, tri, BinnedTriangle);
+
+        for (int ty = tri.minY / TileSize - tileMinY; ty <= tri.maxY / TileSize - tileMinY; ++ty)
+            for (int tx = tri.minX / TileSize - tileMinX; tx <= tri.maxX / TileSize - tileMinX; ++tx)
+                offsets[ty * tilesX + tx + 1]++;
+    }
+
+    if (Vector_is_empty(&rs->m_binnedTriangles))
+        return;
+
+    // Turn the counts into offsets into the bin array.
+    for (int t = 0; t < tileCount; ++t)
+        offsets[t + 1] += offsets[t];
+
+    Vector_clear(&rs->m_tileTriangles);
+    Vector_set_size(&rs->m_tileTriangles, offsets[tileCount]);
+    int *bins = rs->m_tileTriangles.data;
+
+    // Fill the bins in submission order so that each tile draws its
+    // triangles in the same order as the non-tiled modes.
+    int triangleCount = Vector_size(&rs->m_binnedTriangles);
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        BinnedTriangle *tri = &Vector_element(&rs->m_binnedTriangles, i, BinnedTriangle);
+
+        for (int ty = tri->minY / TileSize - tileMinY; ty <= tri->maxY / TileSize - tileMinY; ++ty)
+            for (int tx = tri->minX / TileSize - tileMinX; tx <= tri->maxX / TileSize - tileMinX; ++tx)
+                bins[offsets[ty * tilesX + tx]++] = i;
+    }
+
+    // Filling advanced every offset to the start of the next bin, so the
+    // bin of tile t now starts at offsets[t - 1].
+    for (int t = tileCount; t > 0; --t)
+        offsets[t] = offsets[t - 1];
+    offsets[0] = 0;
+
+    // Every tile is owned by exactly one job so no synchronization is
+    // needed between the tiles.
+    TileJob job = { rs, tileMinX, tileMinY, tilesX };
+    JobSystem_parallelFor(tileCount, TileGrain, Rasterizer_tileJob, &job);
+}
+
+void Rasterizer_tileJob(void *data, int begin, int end)
+{
+    const TileJob *job = data;
+    const int *offsets = job->rs->m_tileOffsets.data;
+
+    for (int t = begin; t < end; ++t)
+    {
+        if (offsets[t] == offsets[t + 1])
+            continue;
+
+        Rasterizer_drawTile(job->rs, (job->tileMinX + t % job->tilesX) * TileSize, (job->tileMinY + t / job->tilesX) * TileSize, t);
+    }
+}
+
+void Rasterizer_drawTile(Rasterizer *rs, int tileX, int tileY, int binIndex)
+{
+    const int *offsets = rs->m_tileOffsets.data;
+    const int *bins = rs->m_tileTriangles.data;
+
+    for (int i = offsets[binIndex]; i < offsets[binIndex + 1]; ++i)
+    {
+        BinnedTriangle *tri = &Vector_element(&rs->m_binnedTriangles, bins[i], BinnedTriangle);
+
+        // Clip the bounding box to the tile and round to block grid.
+        int minX = max(tri->minX, tileX) & ~(BlockSize - 1);
+        int maxX = min(tri->maxX, tileX + TileSize - 1) & ~(BlockSize - 1);
+        int minY = max(tri->minY, tileY) & ~(BlockSize - 1);
+        int maxY = min(tri->maxY, tileY + TileSize - 1) & ~(BlockSize - 1);
+
+        CoverageClass cc = Coverage_classifyRect(&tri->eqn, minX, minY, maxX + BlockSize - minX, maxY + BlockSize - minY, rs->m_fixedPoint);
+        if (cc == CC_Outside)
+            continue;
+
+        for (int y = minY; y <= maxY; y += BlockSize)
+            for (int x = minX; x <= maxX; x += BlockSize)
+            {
+                uint64_t mask = Rasterizer_triangleBlockMask(rs, &tri->eqn, x, y, cc == CC_Inside);
+                if (!mask)
+                    continue;
+
+                if (rs->m_visibility)
+                    Rasterizer_recordBinnedTriangle(rs, tri);
+                else if (!tri->paramsReady)
+                {
+                    // Not synchronized: only triangles inside a single tile get
+                    // here, and a tile is drawn by one job. The others were set
+                    // up when they were binned.
+                    assert(tri->minX / TileSize == tri->maxX / TileSize && tri->minY / TileSize == tri->maxY / TileSize);
+                    Rasterizer_setupParams(rs, &tri->eqn, tri->v0, tri->v1, tri->v2);
+                    tri->paramsReady = true;
+                }
+
+                Rasterizer_shadeBlock(rs, &tri->eqn, x, y, mask);
+            }
+    }
+}
+
+int Rasterizer_recordVertices(Rasterizer *rs, const RasterizerVertex *const *vertices, int count, int *drawIndex)
+{
+    // Start a new draw whenever the state used for shading changes.
+    int draw = Vector_size(&rs->m_visibilityDraws) - 1;
+    VisibilityDraw *last = draw >= 0 ? &Vector_element(&rs->m_visibilityDraws, draw, VisibilityDraw) : 0;
+
+    if (!last || last->pixelShader != rs->m_pixelShader || last->kernels.drawBlock != rs->m_kernels.drawBlock ||
+        last->vertexStride != rs->m_vertexStride || last->pvarOffset != rs->m_pvarOffset)
+    {
+        VisibilityDraw d = { rs->m_pixelShader, rs->m_kernels, rs->m_vertexStride, rs->m_pvarOffset };
+        Vector_append(&rs->m_visibilityDraws, d, VisibilityDraw);
+        ++draw;
+    }
+
+    // Copy the vertices as the arrays may be reused before resolving.
+    int stride = rs->m_vertexStride;
+    int offset = Vector_size(&rs->m_visibilityVertices);
+    Vector_set_size(&rs->m_visibilityVertices, offset + count * stride);
+
+    char *dst = (char*)rs->m_visibilityVertices.data + offset;
+    for (int i = 0; i < count; ++i)
+        memcpy(dst + i * stride, vertices[i], stride);
+
+    *drawIndex = draw;
+    return offset;
+}
+
+uint32_t Rasterizer_recordTriangle(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+{
+    const RasterizerVertex *vertices[3] = { v0, v1, v2 };
+    int draw;
+    int offset = Rasterizer_recordVertices(rs, vertices, 3, &draw);
+
+    VisibilityTriangle tri = { draw, offset };
+    Vector_append(&rs->m_visibilityTriangles, tri, VisibilityTriangle);
+
+    return (uint32_t)(Vector_size(&rs->m_visibilityTriangles) - 1);
+}
+
+void Rasterizer_recordBinnedTriangle(Rasterizer *rs, BinnedTriangle *tri)
+{
+    // Several tile jobs can find the first covered pixel of a triangle at
+    // the same time. The id is published before the flag.
+    if (Atomic_load(&tri->recorded))
+        return;
+
+    while (!Atomic_compareExchange(&rs->m_visibilityLock, 0, 1))
+        ;
+
+    if (!tri->recorded)
+    {
+        tri->eqn.id = Rasterizer_recordTriangle(rs, tri->v0, tri->v1, tri->v2);
+        Atomic_store(&tri->recorded, 1);
+    }
+
+    Atomic_store(&rs->m_visibilityLock, 0);
+}
+
+void Rasterizer_recordPrimitive(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1)
+{
+    const RasterizerVertex *vertices[2] = { v0, v1 };
+    int count = v1 ? 2 : 1;
+    int draw;
+    int offset = Rasterizer_recordVertices(rs, vertices, count, &draw);
+
+    VisibilityPrimitive primitive = { draw, offset, count };
+    Vector_append(&rs->m_visibilityPrimitives, primitive, VisibilityPrimitive);
+}
+
+void Rasterizer_drawRecordedPrimitives(Rasterizer *rs)
+{
+    PixelShader *ps = rs->m_pixelShader;
+    int stride = rs->m_vertexStride;
+    int pvarOffset = rs->m_pvarOffset;
+    bool visibility = rs->m_visibility;
+
+    // Draw with the state recorded for each primitive as in the immediate mode.
+    rs->m_visibility = false;
+
+    for (int i = 0; i < Vector_size(&rs->m_visibilityPrimitives); ++i)
+    {
+        const VisibilityPrimitive *primitive = &Vector_element(&rs->m_visibilityPrimitives, i, VisibilityPrimitive);
+        const VisibilityDraw *draw = &Vector_element(&rs->m_visibilityDraws, primitive->draw, VisibilityDraw);
+        if (!draw->pixelShader)
+            continue;
+
+        rs->m_pixelShader = draw->pixelShader;
+        Rasterizer_setVertexLayout(rs, draw->vertexStride, draw->pvarOffset);
+
+        const char *vertices = (const char*)rs->m_visibilityVertices.data + primitive->vertexOffset;
+        const RasterizerVertex *v0 = (const RasterizerVertex*)vertices;
+        const RasterizerVertex *v1 = (const RasterizerVertex*)(vertices + draw->vertexStride);
+
+        if (primitive->vertexCount == 1)
+            Rasterizer_drawPointTemplate(rs, v0);
+        else
+            Rasterizer_drawLineTemplate(rs, v0, v1);
+    }
+
+    rs->m_visibility = visibility;
+    rs->m_pixelShader = ps;
+    Rasterizer_setVertexLayout(rs, stride, pvarOffset);
+}
+
+void Rasterizer_resolveVisibility(Rasterizer *rs)
+{
+    if (!Vector_is_empty(&rs->m_visibilityTriangles))
+    {
+        VisibilityBuffer *vb = &rs->m_visibilityBuffer;
+        VisibilityJob job = { rs };
+        JobSystem_parallelFor(vb->m_blocksX * vb->m_blocksY, BlockGrain, Rasterizer_visibilityJob, &job);
+    }
+
+    // Points and lines go on top of the triangles in submission order.
+    if (!Vector_is_empty(&rs->m_visibilityPrimitives))
+        Rasterizer_drawRecordedPrimitives(rs);
+
+    Vector_clear(&rs->m_visibilityDraws);
+    Vector_clear(&rs->m_visibilityTriangles);
+    Vector_clear(&rs->m_visibilityPrimitives);
+    Vector_clear(&rs->m_visibilityVertices);
+}
+
+void Rasterizer_visibilityJob(void *data, int begin, int end)
+{
+    const VisibilityJob *job = data;
+    Rasterizer *rs = job->rs;
+    VisibilityBuffer *vb = &rs->m_visibilityBuffer;
+
+    // Neighbouring blocks mostly show the same triangles, so keep the
+    // equations of the last one.
+    TriangleEquations eqn;
+    const VisibilityDraw *draw = 0;
+    uint32_t current = VisibilityEmpty;
+
+    for (int b = begin; b < end; ++b)
+    {
+        int x = b % vb->m_blocksX * BlockSize;
+        int y = b / vb->m_blocksX * BlockSize;
+        uint32_t *ids = VisibilityBuffer_block(vb, x, y);
+
+        // Shade the pixels of each triangle in the block with one call and
+        // clear them for the next frame.
+        for (int i = 0; i < BlockSize * BlockSize; ++i)
+        {
+            uint32_t id = ids[i];
+            if (id == VisibilityEmpty)
+                continue;
+
+            uint64_t mask = 0;
+            for (int j = i; j < BlockSize * BlockSize; ++j)
+            {
+                if (ids[j] == id)
+                {
+                    mask |= (uint64_t)1 << j;
+                    ids[j] = VisibilityEmpty;
+                }
+            }
+
+            if (id != current)
+            {
+                draw = Rasterizer_rebuildTriangle(rs, id, &eqn);
+                current = id;
+            }
+
+            if (draw->pixelShader)
+                draw->kernels.drawBlock(draw->pixelShader, &rs->m_output, &eqn, x, y, mask);
+        }
     }
-}
\ No newline at end of file
+}
+
+const VisibilityDraw *Rasterizer_rebuildTriangle(Rasterizer *rs, uint32_t id, TriangleEquations *eqn)
+{
+    const VisibilityTriangle *tri = &Vector_element(&rs->m_visibilityTriangles, id, VisibilityTriangle);
+    const VisibilityDraw *draw = &Vector_element(&rs->m_visibilityDraws, tri->draw, VisibilityDraw);
+    const PixelShader *ps = draw->pixelShader;
+
+    const char *vertices = (const char*)rs->m_visibilityVertices.data + tri->vertexOffset;
+    const RasterizerVertex *v0 = (const RasterizerVertex*)vertices;
+    const RasterizerVertex *v1 = (const RasterizerVertex*)(vertices + draw->vertexStride);
+    const RasterizerVertex *v2 = (const RasterizerVertex*)(vertices + 2 * draw->vertexStride);
+
+    TriangleEquations_constructEdges(eqn, v0, v1, v2);
+    eqn->id = id;
+
+    if (ps)
+    {
+        TriangleEquations_constructDepth(eqn, v0, v1, v2);
+        TriangleEquations_constructParams(eqn, v0, v1, v2, ps->InterpolateW, ps->AVarCount, ps->PVarCount, draw->pvarOffset);
+    }
+
+    return draw;
+}
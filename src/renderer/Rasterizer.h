@@ -28,9 +28,74 @@ SOFTWARE.
 
 #include "Renderer.h"
 #include "PixelShader.h"
+#include "PixelKernels.h"
+#include "DepthBuffer.h"
+#include "VisibilityBuffer.h"
+#include "Vector.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 
+/// Triangle binned into the screen tiles for RM_Tiled.
+typedef struct {
+	TriangleEquations eqn;
+
+	// Bounding box clipped to the scissor rect (inclusive).
+	int minX;
+	int maxX;
+	int minY;
+	int maxY;
+
+	// Vertices for the deferred parameter setup.
+	const RasterizerVertex *v0;
+	const RasterizerVertex *v1;
+	const RasterizerVertex *v2;
+	bool paramsReady;
+
+	// Set once the triangle is recorded in the visibility buffer mode.
+	volatile long recorded;
+} BinnedTriangle;
+
+/// Triangle drawn in span mode.
+/** The scanlines are drawn in parallel and the first one with a visible
+  pixel sets up the parameters. */
+typedef struct {
+	TriangleEquations eqn;
+
+	const RasterizerVertex *v0;
+	const RasterizerVertex *v1;
+	const RasterizerVertex *v2;
+
+	// 0 before the parameter setup, 1 during it and 2 after it.
+	volatile long state;
+} SpanTriangle;
+
+/// State of a draw recorded in the visibility buffer mode.
+typedef struct {
+	PixelShader *pixelShader;
+	PixelKernels kernels;
+	int vertexStride;
+	int pvarOffset;
+} VisibilityDraw;
+
+/// Triangle recorded in the visibility buffer mode.
+typedef struct {
+	int draw;
+	// Byte offset of the three vertex copies.
+	int vertexOffset;
+} VisibilityTriangle;
+
+/// Point or line recorded in the visibility buffer mode.
+typedef struct {
+	int draw;
+	int vertexOffset;
+	int vertexCount;
+} VisibilityPrimitive;
+
+
+/// Triangles whose pixel footprint is at most this size in both directions
+/// skip the block setup. Not used in span mode, which has a different fill rule.
+enum { MicroTriangleSize = 4 };
 
 /// Rasterizer main class.
 typedef struct Rasterizer_s
@@ -41,8 +106,43 @@ typedef struct Rasterizer_s
 	int m_maxY;
 
 	RasterMode rasterMode;
+	bool m_fixedPoint;
 
     PixelShader *m_pixelShader;
+	// Render target and blend state for batch pixel shaders.
+	OutputMerger m_output;
+	// Pixel loops specialized for the pixel shader settings, selected for
+	// the revision of the pixel shader in m_kernelsRevision.
+	PixelKernels m_kernels;
+	unsigned m_kernelsRevision;
+
+	// Layout of the vertex arrays passed to the list functions.
+	int m_vertexStride;
+	int m_pvarOffset;
+
+	bool m_depthTest;
+	DepthBuffer m_depthBuffer;
+
+	// Tile binning state for RM_Tiled.
+	Vector m_binnedTriangles;
+	Vector m_tileOffsets;
+	Vector m_tileTriangles;
+
+	// Coverage masks of the blocks of the current triangle in block mode.
+	Vector m_blockMasks;
+
+	// Visibility buffer mode state. The triangles keep copies of their
+	// vertices until they are shaded by Rasterizer_resolveVisibility.
+	// A pixel only keeps one id, so blending can not see the triangles
+	// behind it.
+	bool m_visibility;
+	VisibilityBuffer m_visibilityBuffer;
+	Vector m_visibilityDraws;
+	Vector m_visibilityTriangles;
+	Vector m_visibilityPrimitives;
+	Vector m_visibilityVertices;
+	// Serializes the recording of binned triangles by the tile jobs.
+	volatile long m_visibilityLock;
 
 	void (*m_triangleFunc)(struct Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
 	void (*m_lineFunc)(struct Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1);
@@ -51,12 +151,50 @@ typedef struct Rasterizer_s
 
 /// Constructor.
 void Rasterizer_construct(Rasterizer *rs);
+/// Destructor.
+void Rasterizer_destruct(Rasterizer *rs);
 /// Set the raster mode. The default is RasterMode::Span.
 void Rasterizer_setRasterMode(Rasterizer *rs, RasterMode mode);
+/// Enable fixed point edge equations for the block and tiled modes.
+void Rasterizer_setFixedPoint(Rasterizer *rs, bool enable);
 /// Set the scissor rectangle.
 void Rasterizer_setScissorRect(Rasterizer *rs, int x, int y, int width, int height);
+/// Enable the depth test against the built-in depth buffer.
+void Rasterizer_setDepthTest(Rasterizer *rs, bool enable);
+/// Clear the built-in depth buffer.
+void Rasterizer_clearDepth(Rasterizer *rs, float depth);
 /// Set the pixel shader.
 void Rasterizer_setPixelShader(Rasterizer *rs, PixelShader *ps);
+/// Rasterize triangles into the visibility buffer instead of shading them.
+void Rasterizer_setVisibilityMode(Rasterizer *rs, bool enable);
+/// Shade the pixels of the visibility buffer once each.
+void Rasterizer_resolveVisibility(Rasterizer *rs);
+/// Copy vertices for the visibility buffer mode. Returns their byte offset.
+int Rasterizer_recordVertices(Rasterizer *rs, const RasterizerVertex *const *vertices, int count, int *drawIndex);
+/// Record a triangle for the visibility buffer mode and return its id.
+uint32_t Rasterizer_recordTriangle(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+/// Record a binned triangle once, from any tile job.
+void Rasterizer_recordBinnedTriangle(Rasterizer *rs, BinnedTriangle *tri);
+/// Record a point (v1 is NULL) or a line for the visibility buffer mode.
+void Rasterizer_recordPrimitive(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1);
+/// Draw the recorded points and lines.
+void Rasterizer_drawRecordedPrimitives(Rasterizer *rs);
+/// Set up the equations of a recorded triangle and return its draw.
+const VisibilityDraw *Rasterizer_rebuildTriangle(Rasterizer *rs, uint32_t id, TriangleEquations *eqn);
+void Rasterizer_visibilityJob(void *data, int begin, int end);
+void Rasterizer_setRenderTarget(Rasterizer *rs, RenderTarget *rt);
+
+/// Set the layout of the vertex arrays passed to the list functions.
+/** stride is in bytes and pvarOffset is the index of the first perspective
+  variable in floats. The first 4 + AVarCount floats must match RasterizerVertex. */
+void Rasterizer_setVertexLayout(Rasterizer *rs, int stride, int pvarOffset);
+/// Go back to arrays of RasterizerVertex.
+void Rasterizer_setDefaultVertexLayout(Rasterizer *rs);
+
+static inline const RasterizerVertex *Rasterizer_vertex(const Rasterizer *rs, const RasterizerVertex *vertices, int index)
+{
+    return (const RasterizerVertex*)((const char*)vertices + (size_t)index * rs->m_vertexStride);
+}
 /// Draw a single point.
 void Rasterizer_drawPoint(Rasterizer *rs, const RasterizerVertex *v);
 /// Draw a single line.
@@ -72,9 +210,30 @@ PixelData Rasterizer_pixelDataFromVertex(Rasterizer *rs, const RasterizerVertex
 void Rasterizer_drawLineTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1);
 void Rasterizer_stepVertex(Rasterizer *rs, RasterizerVertex *v, RasterizerVertex *step);
 RasterizerVertex Rasterizer_computeVertexStep(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, int adx);
+/// Set up the edge equations and the depth equation if the depth test is enabled.
+/** Returns false if the triangle is backfacing. */
+bool Rasterizer_setupTriangle(Rasterizer *rs, TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+/// Set up the parameter equations consumed by the pixel shader.
+/** Deferred until the triangle is known to cover at least one pixel. */
+void Rasterizer_setupParams(Rasterizer *rs, TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+/// Get the range of pixels whose centers lie in the bounding box of the triangle, clipped to the scissor rect.
+/** The range is inclusive. Returns false if it is empty. */
+bool Rasterizer_sampleBounds(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, int *x0, int *y0, int *x1, int *y1);
+void Rasterizer_drawMicroTriangle(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, int x, int y, int w, int h);
+uint64_t Rasterizer_scissorMask(Rasterizer *rs, int x, int y);
+uint64_t Rasterizer_triangleBlockMask(Rasterizer *rs, const TriangleEquations *eqn, int x, int y, bool inside);
+void Rasterizer_drawSpan(Rasterizer *rs, SpanTriangle *tri, int x, int y, int x2);
+/// Set up the parameters of tri once, from any span job.
+void Rasterizer_setupSpanParams(Rasterizer *rs, SpanTriangle *tri);
 void Rasterizer_drawTriangleBlockTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+void Rasterizer_blockMaskJob(void *data, int begin, int end);
+void Rasterizer_blockShadeJob(void *data, int begin, int end);
 void Rasterizer_drawTriangleSpanTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
-void Rasterizer_drawBottomFlatTriangle(Rasterizer *rs, const TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
-void Rasterizer_drawTopFlatTriangle(Rasterizer *rs, const TriangleEquations *eqn, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+void Rasterizer_drawBottomFlatTriangle(Rasterizer *rs, SpanTriangle *tri, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+void Rasterizer_drawTopFlatTriangle(Rasterizer *rs, SpanTriangle *tri, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+void Rasterizer_spanJob(void *data, int begin, int end);
 void Rasterizer_drawTriangleAdaptiveTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
-void Rasterizer_drawTriangleModeTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
\ No newline at end of file
+void Rasterizer_drawTriangleModeTemplate(Rasterizer *rs, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
+void Rasterizer_drawTriangleListTiled(Rasterizer *rs, const RasterizerVertex *vertices, const int *indices, unsigned long indexCount);
+void Rasterizer_drawTile(Rasterizer *rs, int tileX, int tileY, int binIndex);
+void Rasterizer_tileJob(void *data, int begin, int end);
\ No newline at end of file
@@ -0,0 +1,373 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "RenderTarget.h"
+#include "Memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SR_X86
+#endif
+
+#if defined(SR_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SR_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+static inline uint32_t packRGBA8(float r, float g, float b, float a)
+{
+    float c[4] = { r, g, b, a };
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        float v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+        bytes[i] = (uint8_t)(v * 255.0f + 0.5f);
+    }
+
+    uint32_t packed;
+    memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+}
+
+static inline void storeLane(RenderTarget *rt, const PixelBatch *batch, int offset, int i)
+{
+    switch (rt->m_format)
+    {
+    case RTF_RGBA8:
+        ((uint32_t*)rt->m_data)[offset] = packRGBA8(batch->color[0][i], batch->color[1][i], batch->color[2][i], batch->color[3][i]);
+        break;
+    case RTF_R32F:
+        ((float*)rt->m_data)[offset] = batch->color[0][i];
+        break;
+    case RTF_D32F:
+        ((float*)rt->m_data)[offset] = batch->z[i];
+        break;
+    }
+}
+
+void RenderTarget_construct(RenderTarget *rt, RenderTargetFormat format, int width, int height)
+{
+    rt->m_format = format;
+    rt->m_width = width;
+    rt->m_height = height;
+    rt->m_blocksX = (width + BlockSize - 1) / BlockSize;
+    rt->m_blocksY = (height + BlockSize - 1) / BlockSize;
+
+    // All formats use 4 bytes per pixel.
+    rt->m_data = Memory_alignedAlloc((size_t)rt->m_blocksX * rt->m_blocksY * BlockSize * BlockSize * 4, 64);
+
+    RenderTarget_clear(rt, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void RenderTarget_destruct(RenderTarget *rt)
+{
+    Memory_alignedFree(rt->m_data);
+    rt->m_data = 0;
+}
+
+int RenderTarget_width(const RenderTarget *rt)
+{
+    return rt->m_width;
+}
+
+int RenderTarget_height(const RenderTarget *rt)
+{
+    return rt->m_height;
+}
+
+RenderTargetFormat RenderTarget_format(const RenderTarget *rt)
+{
+    return rt->m_format;
+}
+
+void RenderTarget_clear(RenderTarget *rt, float r, float g, float b, float a)
+{
+    int count = rt->m_blocksX * rt->m_blocksY * BlockSize * BlockSize;
+
+    if (rt->m_format == RTF_RGBA8)
+    {
+        uint32_t value = packRGBA8(r, g, b, a);
+        uint32_t *data = rt->m_data;
+        for (int i = 0; i < count; ++i)
+            data[i] = value;
+    }
+    else
+    {
+        float *data = rt->m_data;
+        for (int i = 0; i < count; ++i)
+            data[i] = r;
+    }
+}
+
+void RenderTarget_resolve(const RenderTarget *rt, void *dst, int pitch)
+{
+    const uint8_t *src = rt->m_data;
+    uint8_t *out = dst;
+
+    for (int by = 0; by < rt->m_blocksY; ++by)
+    {
+        int rows = rt->m_height - by * BlockSize;
+        if (rows > BlockSize) rows = BlockSize;
+
+        for (int bx = 0; bx < rt->m_blocksX; ++bx)
+        {
+            int cols = rt->m_width - bx * BlockSize;
+            if (cols > BlockSize) cols = BlockSize;
+
+            const uint8_t *block = src + (size_t)(by * rt->m_blocksX + bx) * BlockSize * BlockSize * 4;
+            uint8_t *line = out + (size_t)by * BlockSize * pitch + bx * BlockSize * 4;
+
+            for (int yy = 0; yy < rows; ++yy)
+                memcpy(line + (size_t)yy * pitch, block + yy * BlockSize * 4, cols * 4);
+        }
+    }
+}
+
+void RenderTarget_storeBlock(RenderTarget *rt, const PixelBatch *batch, int x, int y)
+{
+    if (x + BlockSize > rt->m_width || y + BlockSize > rt->m_height)
+    {
+        RenderTarget_storeBatch(rt, batch);
+        return;
+    }
+
+    int base = RenderTarget_offset(rt, x, y);
+    uint64_t mask = batch->mask;
+
+    if (mask == ~(uint64_t)0)
+    {
+        for (int i = 0; i < PixelBatchSize; ++i)
+            storeLane(rt, batch, base + i, i);
+        return;
+    }
+
+    for (int i = 0; mask; ++i, mask >>= 1)
+        if (mask & 1)
+            storeLane(rt, batch, base + i, i);
+}
+
+void RenderTarget_storeBatch(RenderTarget *rt, const PixelBatch *batch)
+{
+    uint64_t mask = batch->mask;
+
+    for (int i = 0; i < batch->count; ++i, mask >>= 1)
+    {
+        if (!(mask & 1))
+            continue;
+
+        int x = batch->x[i];
+        int y = batch->y[i];
+        if (x < 0 || y < 0 || x >= rt->m_width || y >= rt->m_height)
+            continue;
+
+        storeLane(rt, batch, RenderTarget_offset(rt, x, y), i);
+    }
+}
+
+static inline float clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static inline float blendChannel(BlendMode mode, float s, float d, float a)
+{
+    switch (mode)
+    {
+    case BM_Alpha: return s * a + d * (1.0f - a);
+    case BM_Additive: return s + d;
+    case BM_Multiply: return s * d;
+    case BM_PremultipliedAlpha: return s + d * (1.0f - a);
+    default: return s;
+    }
+}
+
+static inline bool OutputMerger_isOpaque(const OutputMerger *om)
+{
+    return om->target->m_format == RTF_D32F ||
+        (om->blendMode == BM_Opaque && om->colorWriteMask == CWM_All);
+}
+
+static void OutputMerger_blendLane(const OutputMerger *om, const PixelBatch *batch, int offset, int i)
+{
+    RenderTarget *rt = om->target;
+    float a = clamp01(batch->color[3][i]);
+
+    // Float targets keep values outside [0, 1], only the alpha is clamped.
+    if (rt->m_format == RTF_R32F)
+    {
+        float *d = (float*)rt->m_data + offset;
+        if (om->colorWriteMask & CWM_Red)
+            *d = blendChannel(om->blendMode, batch->color[0][i], *d, a);
+        return;
+    }
+
+    uint8_t bytes[4];
+    memcpy(bytes, (uint32_t*)rt->m_data + offset, sizeof(bytes));
+
+    for (int c = 0; c < 4; ++c)
+    {
+        if (!(om->colorWriteMask & (1 << c)))
+            continue;
+
+        float d = bytes[c] * (1.0f / 255.0f);
+        float v = clamp01(blendChannel(om->blendMode, clamp01(batch->color[c][i]), d, a));
+        bytes[c] = (uint8_t)(v * 255.0f + 0.5f);
+    }
+
+    memcpy((uint32_t*)rt->m_data + offset, bytes, sizeof(bytes));
+}
+
+#ifdef SR_HAVE_SSE2
+// Blend four consecutive lanes starting at i with the RGBA8 texels in dst.
+// Gives the same results as OutputMerger_blendLane.
+static void OutputMerger_blend4(const OutputMerger *om, const PixelBatch *batch, int i, uint32_t dst[4])
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+
+    __m128i d = _mm_loadu_si128((const __m128i*)dst);
+    __m128i result = d;
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&batch->color[3][i]), zero), one);
+    __m128 ia = _mm_sub_ps(one, a);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        if (!(om->colorWriteMask & (1 << c)))
+            continue;
+
+        __m128 s = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&batch->color[c][i]), zero), one);
+        __m128 dc = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(d, 8 * c), byteMask)), _mm_set1_ps(1.0f / 255.0f));
+        __m128 v;
+
+        switch (om->blendMode)
+        {
+        case BM_Alpha: v = _mm_add_ps(_mm_mul_ps(s, a), _mm_mul_ps(dc, ia)); break;
+        case BM_Additive: v = _mm_add_ps(s, dc); break;
+        case BM_Multiply: v = _mm_mul_ps(s, dc); break;
+        case BM_PremultipliedAlpha: v = _mm_add_ps(s, _mm_mul_ps(dc, ia)); break;
+        default: v = s; break;
+        }
+
+        v = _mm_min_ps(_mm_max_ps(v, zero), one);
+        __m128i packed = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+
+        result = _mm_andnot_si128(_mm_slli_epi32(byteMask, 8 * c), result);
+        result = _mm_or_si128(result, _mm_slli_epi32(packed, 8 * c));
+    }
+
+    _mm_storeu_si128((__m128i*)dst, result);
+}
+#endif
+
+// Blend the lanes of batch with a non negative offset into the target.
+static void OutputMerger_blend(const OutputMerger *om, const PixelBatch *batch, const int *offsets)
+{
+    int i = 0;
+
+#ifdef SR_HAVE_SSE2
+    if (om->target->m_format == RTF_RGBA8)
+    {
+        uint32_t *data = om->target->m_data;
+
+        for (; i + 4 <= batch->count; i += 4)
+        {
+            if ((offsets[i] & offsets[i + 1] & offsets[i + 2] & offsets[i + 3]) < 0)
+                continue;
+
+            uint32_t texels[4];
+            for (int j = 0; j < 4; ++j)
+                texels[j] = offsets[i + j] >= 0 ? data[offsets[i + j]] : 0;
+
+            OutputMerger_blend4(om, batch, i, texels);
+
+            for (int j = 0; j < 4; ++j)
+                if (offsets[i + j] >= 0)
+                    data[offsets[i + j]] = texels[j];
+        }
+    }
+#endif
+
+    for (; i < batch->count; ++i)
+        if (offsets[i] >= 0)
+            OutputMerger_blendLane(om, batch, offsets[i], i);
+}
+
+void OutputMerger_storeBlock(const OutputMerger *om, const PixelBatch *batch, int x, int y)
+{
+    RenderTarget *rt = om->target;
+    if (!rt)
+        return;
+
+    if (OutputMerger_isOpaque(om))
+    {
+        RenderTarget_storeBlock(rt, batch, x, y);
+        return;
+    }
+
+    if (x + BlockSize > rt->m_width || y + BlockSize > rt->m_height)
+    {
+        OutputMerger_storeBatch(om, batch);
+        return;
+    }
+
+    // The lanes of a block batch map to consecutive pixels.
+    int offsets[PixelBatchSize];
+    int base = RenderTarget_offset(rt, x, y);
+    uint64_t mask = batch->mask;
+
+    for (int i = 0; i < batch->count; ++i, mask >>= 1)
+        offsets[i] = (mask & 1) ? base + i : -1;
+
+    OutputMerger_blend(om, batch, offsets);
+}
+
+void OutputMerger_storeBatch(const OutputMerger *om, const PixelBatch *batch)
+{
+    RenderTarget *rt = om->target;
+    if (!rt)
+        return;
+
+    if (OutputMerger_isOpaque(om))
+    {
+        RenderTarget_storeBatch(rt, batch);
+        return;
+    }
+
+    int offsets[PixelBatchSize];
+    uint64_t mask = batch->mask;
+
+    for (int i = 0; i < batch->count; ++i, mask >>= 1)
+    {
+        int x = batch->x[i];
+        int y = batch->y[i];
+        bool inside = x >= 0 && y >= 0 && x < rt->m_width && y < rt->m_height;
+        offsets[i] = (mask & 1) && inside ? RenderTarget_offset(rt, x, y) : -1;
+    }
+
+    OutputMerger_blend(om, batch, offsets);
+}
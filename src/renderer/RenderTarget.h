@@ -0,0 +1,77 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "Renderer.h"
+
+#include <stdint.h>
+
+/// Render target with a block tiled memory layout.
+/** The surface is split into BlockSize x BlockSize blocks stored in row major
+  block order. The pixels of a block are contiguous and row major, so an RGBA8
+  or 32 bit float block is exactly four 64 byte cache lines. The storage is
+  aligned to 64 bytes. Use RenderTarget_resolve to get a linear image. */
+typedef struct RenderTarget_s {
+	RenderTargetFormat m_format;
+
+	int m_width;
+	int m_height;
+	int m_blocksX;
+	int m_blocksY;
+
+	void *m_data;
+} RenderTarget;
+
+void RenderTarget_construct(RenderTarget *rt, RenderTargetFormat format, int width, int height);
+void RenderTarget_destruct(RenderTarget *rt);
+
+/// Store the covered lanes of a block batch at (x, y).
+void RenderTarget_storeBlock(RenderTarget *rt, const PixelBatch *batch, int x, int y);
+/// Store the covered lanes of an arbitrary batch.
+void RenderTarget_storeBatch(RenderTarget *rt, const PixelBatch *batch);
+
+/// Render target together with the blend state applied when storing batches.
+typedef struct OutputMerger_s {
+	RenderTarget *target;
+	BlendMode blendMode;
+	int colorWriteMask;
+} OutputMerger;
+
+/// Blend the covered lanes of a block batch at (x, y) into the target.
+/** Does nothing without a target. Opaque stores of all channels take the
+  RenderTarget_storeBlock path. */
+void OutputMerger_storeBlock(const OutputMerger *om, const PixelBatch *batch, int x, int y);
+/// Blend the covered lanes of an arbitrary batch into the target.
+void OutputMerger_storeBatch(const OutputMerger *om, const PixelBatch *batch);
+
+/// Offset in pixels of (x, y) from the start of the storage.
+static inline int RenderTarget_offset(const RenderTarget *rt, int x, int y)
+{
+    int block = (y / BlockSize) * rt->m_blocksX + x / BlockSize;
+    return block * BlockSize * BlockSize + (y % BlockSize) * BlockSize + x % BlockSize;
+}
@@ -27,6 +27,9 @@ SOFTWARE.
 #include "Renderer.h"
 #include "Rasterizer.h"
 #include "VertexProcessor.h"
+#include "RenderTarget.h"
+#include "Texture.h"
+#include "JobSystem.h"
 #include "Vector.h"
 
 #include <stdlib.h>
@@ -35,11 +38,27 @@ static Vector g_object_ptrs;
 // We need to store VertexProcessor pointers separately as they
 // require a call to the "destruct" method as well
 static Vector g_vertex_processor_ptrs;
+// Same for the rasterizers
+static Vector g_rasterizer_ptrs;
+// And the render targets
+static Vector g_render_target_ptrs;
+// And the textures
+static Vector g_texture_ptrs;
 
 void SoftwareRenderer_init()
 {
+    SoftwareRenderer_initWithThreadCount(0);
+}
+
+void SoftwareRenderer_initWithThreadCount(int threadCount)
+{
+    JobSystem_init(threadCount);
+
     Vector_init(&g_object_ptrs, sizeof(void*));
     Vector_init(&g_vertex_processor_ptrs, sizeof(void*));
+    Vector_init(&g_rasterizer_ptrs, sizeof(void*));
+    Vector_init(&g_render_target_ptrs, sizeof(void*));
+    Vector_init(&g_texture_ptrs, sizeof(void*));
 }
 
 void SoftwareRenderer_destroy()
@@ -51,12 +70,35 @@ void SoftwareRenderer_destroy()
         VertexProcessor_destruct(ptr);
     }
 
+    // Call destructors for all rasterizer objects
+    for (int i = 0; i < Vector_size(&g_rasterizer_ptrs); i++)
+    {
+        void *ptr = Vector_element(&g_rasterizer_ptrs, i, void*);
+        Rasterizer_destruct(ptr);
+    }
+
+    // Call destructors for all render target objects
+    for (int i = 0; i < Vector_size(&g_render_target_ptrs); i++)
+    {
+        void *ptr = Vector_element(&g_render_target_ptrs, i, void*);
+        RenderTarget_destruct(ptr);
+    }
+
+    // Call destructors for all texture objects
+    for (int i = 0; i < Vector_size(&g_texture_ptrs); i++)
+    {
+        void *ptr = Vector_element(&g_texture_ptrs, i, void*);
+        Texture_destruct(ptr);
+    }
+
     // Free memory for all allocated objects
     for (int i = 0; i < Vector_size(&g_object_ptrs); i++)
     {
         void *ptr = Vector_element(&g_object_ptrs, i, void*);
         free(ptr);
     }
+
+    JobSystem_shutdown();
 }
 
 VertexProcessor* SoftwareRenderer_createVertexProcessor(Rasterizer *r)
@@ -73,6 +115,7 @@ Rasterizer* SoftwareRenderer_createRasterizer()
     Rasterizer *ptr = malloc(sizeof(Rasterizer));
     Rasterizer_construct(ptr);
     Vector_append(&g_object_ptrs, ptr, void*);
+    Vector_append(&g_rasterizer_ptrs, ptr, void*);
     return ptr;
 }
 
@@ -92,4 +135,22 @@ PixelShader* SoftwareRenderer_createPixelShader(bool interpZ, bool interpW, int
     PixelShader_init(ptr, interpZ, interpW, affineCount, perspCount, callback);
     Vector_append(&g_object_ptrs, ptr, void*);
     return ptr;
-}
\ No newline at end of file
+}
+
+RenderTarget* SoftwareRenderer_createRenderTarget(RenderTargetFormat format, int width, int height)
+{
+    RenderTarget *ptr = malloc(sizeof(RenderTarget));
+    RenderTarget_construct(ptr, format, width, height);
+    Vector_append(&g_object_ptrs, ptr, void*);
+    Vector_append(&g_render_target_ptrs, ptr, void*);
+    return ptr;
+}
+
+Texture* SoftwareRenderer_createTexture(TextureFormat format, int width, int height)
+{
+    Texture *ptr = malloc(sizeof(Texture));
+    Texture_construct(ptr, format, width, height);
+    Vector_append(&g_object_ptrs, ptr, void*);
+    Vector_append(&g_texture_ptrs, ptr, void*);
+    return ptr;
+}
@@ -25,6 +25,7 @@ SOFTWARE.
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 #define SR_API extern "C"
@@ -32,6 +33,12 @@ SOFTWARE.
 #define SR_API
 #endif
 
+#if defined(_MSC_VER)
+#define SR_ALIGN(n) __declspec(align(n))
+#else
+#define SR_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
 /// Primitive draw mode.
 typedef enum {
     DM_Point,
@@ -46,20 +53,74 @@ typedef enum {
     CM_CW
 } CullMode;
 
+/// Vertex cache mode.
+typedef enum {
+    VCM_DirectMapped, ///< Small direct mapped cache of VertexCacheSize entries.
+    VCM_Full ///< Every vertex is transformed only once per primitive batch.
+} VertexCacheMode;
+
 /// Rasterizer mode.
 typedef enum {
     RM_Span,
     RM_Block,
-    RM_Adaptive
+    RM_Adaptive, ///< Block or span mode per triangle. Without fixed point the two fill rules can disagree on shared edges.
+    RM_Tiled
 } RasterMode;
 
+/// Render target pixel format.
+typedef enum {
+    RTF_RGBA8, ///< 8 bits per channel, stored as R, G, B, A bytes.
+    RTF_R32F, ///< Single 32 bit float channel.
+    RTF_D32F ///< 32 bit float depth. Stores the interpolated z.
+} RenderTargetFormat;
+
+/// Blend mode of the output merger.
+/** The equation is applied to all four channels with s the source color,
+  d the color in the render target and a the source alpha. Source colors are
+  clamped to [0, 1] first and RGBA8 results are clamped again. */
+typedef enum {
+    BM_Opaque, ///< s
+    BM_Alpha, ///< s * a + d * (1 - a)
+    BM_Additive, ///< s + d
+    BM_Multiply, ///< s * d
+    BM_PremultipliedAlpha ///< s + d * (1 - a)
+} BlendMode;
+
+/// Channels written by the output merger.
+enum {
+    CWM_Red = 1,
+    CWM_Green = 2,
+    CWM_Blue = 4,
+    CWM_Alpha = 8,
+    CWM_All = CWM_Red | CWM_Green | CWM_Blue | CWM_Alpha
+};
+
 typedef struct VertexProcessor_s VertexProcessor;
 typedef struct Rasterizer_s Rasterizer;
 typedef struct VertexShader_s VertexShader;
 typedef struct PixelShader_s PixelShader;
+typedef struct RenderTarget_s RenderTarget;
+typedef struct Texture_s Texture;
+typedef struct TriangleEquations_s TriangleEquations;
+
+/// Texture format.
+typedef enum {
+    TXF_RGBA8, ///< 4 bytes per texel in any channel order.
+    TXF_BC1, ///< 8 byte BC1 (DXT1) blocks. Decodes to R, G, B, A bytes.
+    TXF_BC3 ///< 16 byte BC3 (DXT5) blocks. Decodes to R, G, B, A bytes.
+} TextureFormat;
+
+/// Texture filter used by the samplers.
+typedef enum {
+    TF_Nearest, ///< Nearest texel of the level closest to the lod.
+    TF_Bilinear, ///< Bilinear filtering in the level closest to the lod.
+    TF_Trilinear ///< Bilinear filtering in the two levels around the lod, blended.
+} TextureFilter;
 
 enum {
     BlockSize = 8,
+    /// Size of the screen tiles used by RM_Tiled. Must be a multiple of BlockSize.
+    TileSize = 64,
     /// Maximum affine variables used for interpolation across the triangle.
     MaxAVars = 16,
     /// Maximum perspective variables used for interpolation across the triangle.
@@ -86,8 +147,36 @@ typedef struct {
     float pvar[MaxPVars];
 } VertexShaderOutput;
 
+/// Vertex shader callback. Called from several threads at once.
 typedef void (*ProcessVertexCallback)(VertexShaderInput in, VertexShaderOutput *out);
 
+/// Number of vertices passed to a batch vertex shader at once.
+enum { VertexBatchSize = 8 };
+
+/// A batch of vertices passed to the vertex shader in SoA form.
+/** Attribute i of lane j is at attrib[i] + stride[i] * index[j]. The shader
+  must fill the outputs of the first count lanes. */
+typedef struct {
+    int count; ///< Number of filled lanes.
+    int index[VertexBatchSize]; ///< The vertex indices.
+
+    const void *attrib[MaxVertexAttribs]; ///< The vertex attribute buffers.
+    int stride[MaxVertexAttribs]; ///< The vertex attribute strides in bytes.
+
+    SR_ALIGN(32) float x[VertexBatchSize]; ///< The x components.
+    SR_ALIGN(32) float y[VertexBatchSize]; ///< The y components.
+    SR_ALIGN(32) float z[VertexBatchSize]; ///< The z components.
+    SR_ALIGN(32) float w[VertexBatchSize]; ///< The w components.
+
+    /// Affine variables.
+    SR_ALIGN(32) float avar[MaxAVars][VertexBatchSize];
+
+    /// Perspective variables.
+    SR_ALIGN(32) float pvar[MaxPVars][VertexBatchSize];
+} VertexBatch;
+
+typedef void (*ProcessVertexBatchCallback)(VertexBatch*);
+
 /// PixelData passed to the pixel shader for display.
 typedef struct {
     int x; ///< The x coordinate.
@@ -103,12 +192,47 @@ typedef struct {
     /// Perspective variables.
     float pvar[MaxPVars];
 
+    /// Plane equations of the triangle, NULL for points and lines.
+    /** Used by the derivative functions. */
+    const TriangleEquations *equations;
+
     // Used internally.
     float pvarTemp[MaxPVars];
 } PixelData;
 
 typedef void (*DrawPixelCallback)(const PixelData*);
 
+/// Number of pixels passed to a batch pixel shader at once.
+enum { PixelBatchSize = BlockSize * BlockSize };
+
+/// A batch of pixels passed to the pixel shader in SoA form.
+/** Spans fill the lanes from left to right, blocks fill them row by row.
+  Only lanes whose bit is set in the coverage mask must be shaded. */
+typedef struct {
+    int count; ///< Number of filled lanes.
+    uint64_t mask; ///< Coverage mask. Bit i is set if lane i is covered.
+    const TriangleEquations *equations; ///< Plane equations of the triangle.
+
+    SR_ALIGN(32) int x[PixelBatchSize]; ///< The x coordinates.
+    SR_ALIGN(32) int y[PixelBatchSize]; ///< The y coordinates.
+
+    SR_ALIGN(32) float z[PixelBatchSize]; ///< The interpolated z values.
+    SR_ALIGN(32) float w[PixelBatchSize]; ///< The interpolated w values.
+    SR_ALIGN(32) float invw[PixelBatchSize]; ///< The interpolated 1 / w values.
+
+    /// Affine variables.
+    SR_ALIGN(32) float avar[MaxAVars][PixelBatchSize];
+
+    /// Perspective variables.
+    SR_ALIGN(32) float pvar[MaxPVars][PixelBatchSize];
+
+    /// Output color written by the shader when a render target is bound.
+    /** Channels are r, g, b, a in [0, 1]. R32F targets only use r. */
+    SR_ALIGN(32) float color[4][PixelBatchSize];
+} PixelBatch;
+
+typedef void (*DrawPixelBatchCallback)(PixelBatch*);
+
 /// Vertex input structure for the Rasterizer. Output from the VertexProcessor.
 typedef struct {
     float x; ///< The x component.
@@ -125,11 +249,19 @@ typedef struct {
 
 
 SR_API void SoftwareRenderer_init();
+/// Same as SoftwareRenderer_init but sets the number of threads used for rendering.
+/** threadCount includes the calling thread. 0 uses one thread per processor. */
+SR_API void SoftwareRenderer_initWithThreadCount(int threadCount);
 SR_API void SoftwareRenderer_destroy();
 SR_API VertexProcessor* SoftwareRenderer_createVertexProcessor(Rasterizer *r);
 SR_API Rasterizer* SoftwareRenderer_createRasterizer();
 SR_API VertexShader* SoftwareRenderer_createVertexShader(int attribCount, ProcessVertexCallback callback);
 SR_API PixelShader* SoftwareRenderer_createPixelShader(bool interpZ, bool interpW, int affineCount, int perspCount, DrawPixelCallback callback);
+SR_API RenderTarget* SoftwareRenderer_createRenderTarget(RenderTargetFormat format, int width, int height);
+/// Create a texture with a full mip chain. The texels are initialized to 0.
+/** If the texels can not be allocated the texture is 1x1, stays black and
+  ignores uploads. */
+SR_API Texture* SoftwareRenderer_createTexture(TextureFormat format, int width, int height);
 
 /// Change the rasterizer where the primitives are sent.
 SR_API void VertexProcessor_setRasterizer(VertexProcessor *vp, Rasterizer *rasterizer);
@@ -142,6 +274,16 @@ SR_API void VertexProcessor_setViewport(VertexProcessor *vp, int x, int y, int w
 /** Default is (0, 1) */
 SR_API void VertexProcessor_setDepthRange(VertexProcessor *vp, float n, float f);
 
+/// Set the guard band as a multiple of the viewport size.
+/** Triangles that extend past the viewport sides but stay inside the guard
+  band are not clipped. The rasterizer scissors them to the viewport instead.
+  Only the near and far planes and triangles leaving the guard band are
+  clipped geometrically. Values <= 1 turn the guard band off. Default is 1.
+  The guard band in use is limited to screen coordinates within +-65536
+  (MaxGuardBandCoord) so unclipped triangles stay inside the range of the
+  fixed point rasterizer. */
+SR_API void VertexProcessor_setGuardBand(VertexProcessor *vp, float x, float y);
+
 /// Set the cull mode.
 /** Default is CM_CW to cull clockwise triangles. */
 SR_API void VertexProcessor_setCullMode(VertexProcessor *vp, CullMode mode);
@@ -149,15 +291,180 @@ SR_API void VertexProcessor_setCullMode(VertexProcessor *vp, CullMode mode);
 /// Set the vertex shader.
 SR_API void VertexProcessor_setVertexShader(VertexProcessor *vp, VertexShader *vs);
 
+/// Set the vertex cache mode.
+/** Default is VCM_DirectMapped. */
+SR_API void VertexProcessor_setVertexCacheMode(VertexProcessor *vp, VertexCacheMode mode);
+
+/// Set the number of primitives processed per batch.
+/** 0 picks a size so that a batch fits in the L2 cache. The size follows
+  the vertex layout of the pixel shader used by the next draw. Default is 1024.
+  Vertices used by the end of a batch are carried over to the next one. */
+SR_API void VertexProcessor_setBatchSize(VertexProcessor *vp, int primitives);
+SR_API int VertexProcessor_batchSize(const VertexProcessor *vp);
+
+/// Let draws larger than a batch shade, clip and cull batches on several threads.
+/** The batches are still rasterized in submission order. Default is true. */
+SR_API void VertexProcessor_setParallelFrontEnd(VertexProcessor *vp, bool enable);
+
+/// Shade and clip later batches while earlier ones are rasterized.
+/** Needs the parallel front end. Triangle order is kept. Default is false. */
+SR_API void VertexProcessor_setStreaming(VertexProcessor *vp, bool enable);
+
+/// Get the vertex cache hits and misses counted since the last reset.
+/** A miss is one vertex shader invocation. */
+SR_API void VertexProcessor_vertexCacheStats(const VertexProcessor *vp, unsigned long *hits, unsigned long *misses);
+SR_API void VertexProcessor_resetVertexCacheStats(VertexProcessor *vp);
+
 /// Set a vertex attrib pointer.
 SR_API void VertexProcessor_setVertexAttribPointer(VertexProcessor *vp, int index, int stride, const void *buffer);
 
 /// Draw a number of points, lines or triangles.
 SR_API void VertexProcessor_drawElements(VertexProcessor *vp, DrawMode mode, unsigned long count, int *indices);
 
+/// Set the batch callback of a vertex shader.
+/** If set it is used instead of the per vertex callback. */
+SR_API void VertexShader_setProcessVertexBatch(VertexShader *vs, ProcessVertexBatchCallback callback);
+
+/// Set the batch callback of a pixel shader.
+/** If set it is used instead of the per pixel callback for triangles. */
+SR_API void PixelShader_setDrawPixelBatch(PixelShader *ps, DrawPixelBatchCallback callback);
+
+/// Interpolate the perspective vars of drawPixel linearly between exact values.
+/** The exact values are computed every step pixels along spans and block
+  rows, and more often where the linear interpolation would be off by more
+  than maxError times the change of the vars over the step. A step of 0
+  divides at every pixel, which is the default. Typical steps are 8 or 16. */
+SR_API void PixelShader_setPerspectiveStep(PixelShader *ps, int step, float maxError);
+
+/// Use a reciprocal estimate refined by a Newton-Raphson step for the exact perspective divisions.
+/** Only used together with PixelShader_setPerspectiveStep. Default is false. */
+SR_API void PixelShader_setFastReciprocal(PixelShader *ps, bool enable);
+
+/// Screen space derivatives of an affine variable, constant across the triangle.
+/** Both are 0 for points and lines. */
+SR_API void PixelData_avarDerivatives(const PixelData *p, int index, float *ddx, float *ddy);
+
+/// Screen space derivatives of a perspective variable at the pixel.
+/** Exact at the pixel since they are computed from the plane equations of
+  the variable and of 1 / w. Both are 0 for points and lines. */
+SR_API void PixelData_pvarDerivatives(const PixelData *p, int index, float *ddx, float *ddy);
+
+/// Same as PixelData_avarDerivatives for a lane of a batch.
+SR_API void PixelBatch_avarDerivatives(const PixelBatch *batch, int index, int lane, float *ddx, float *ddy);
+
+/// Same as PixelData_pvarDerivatives for a lane of a batch.
+SR_API void PixelBatch_pvarDerivatives(const PixelBatch *batch, int index, int lane, float *ddx, float *ddy);
+
+SR_API int RenderTarget_width(const RenderTarget *rt);
+SR_API int RenderTarget_height(const RenderTarget *rt);
+SR_API RenderTargetFormat RenderTarget_format(const RenderTarget *rt);
+
+/// Fill the render target. Float formats are set to r.
+SR_API void RenderTarget_clear(RenderTarget *rt, float r, float g, float b, float a);
+
+/// Copy the render target to a linear image with 4 bytes per pixel.
+/** pitch is the size of a row of dst in bytes. */
+SR_API void RenderTarget_resolve(const RenderTarget *rt, void *dst, int pitch);
+
+SR_API int Texture_width(const Texture *tex);
+SR_API int Texture_height(const Texture *tex);
+SR_API int Texture_levelCount(const Texture *tex);
+SR_API TextureFormat Texture_format(const Texture *tex);
+
+/// Upload a linear image with 4 bytes per texel and build the mip chain.
+/** pitch is the size of a row of data in bytes. The channel order is kept
+  as is, so the samplers return texels in the same format. Only for TXF_RGBA8. */
+SR_API void Texture_setImage(Texture *tex, const void *data, int pitch);
+
+/// Upload the blocks of one level of a compressed texture.
+/** The blocks are in row major order as in DDS files, ceil(width / 4) per
+  row. The mip chain is not generated, upload every level that is sampled. */
+SR_API void Texture_setCompressedLevel(Texture *tex, int level, const void *blocks);
+
+/// Sample the texture at the normalized coordinates (u, v) with repeat wrapping.
+/** lod is the base 2 logarithm of the texel to pixel ratio, 0 samples the
+  full resolution level. Nearest and bilinear filtering use the closest level. */
+SR_API uint32_t Texture_sample(const Texture *tex, TextureFilter filter, float u, float v, float lod);
+
+/// Level of detail for the derivatives of the normalized texture coordinates.
+/** Uses the longer of the x and y footprints in texels. The result is
+  negative when the texture is magnified. */
+SR_API float Texture_computeLod(const Texture *tex, float dudx, float dvdx, float dudy, float dvdy);
+
+/// Level of detail of a pixel whose texture coordinates are the perspective variables u and v.
+SR_API float Texture_pixelLod(const Texture *tex, const PixelData *p, int u, int v);
+
+/// Same as Texture_pixelLod for a lane of a batch.
+SR_API float Texture_batchLod(const Texture *tex, const PixelBatch *batch, int u, int v, int lane);
+
+/// Sample four texels at once. lod may be NULL to sample the full resolution level.
+/** Gives the same results as Texture_sample. Bilinear and trilinear filtering
+  use SSE2 where available. */
+SR_API void Texture_sample4(const Texture *tex, TextureFilter filter, const float *u, const float *v, const float *lod, uint32_t *out);
+
+/// Sample eight texels at once, for instance one row of a block batch.
+SR_API void Texture_sample8(const Texture *tex, TextureFilter filter, const float *u, const float *v, const float *lod, uint32_t *out);
+
 SR_API void Rasterizer_setRasterMode(Rasterizer *r, RasterMode mode);
 SR_API void Rasterizer_setScissorRect(Rasterizer *r, int x, int y, int width, int height);
+
+/// Use fixed point edge equations with SubPixelBits of sub-pixel precision.
+/** Only affects the block based modes. Shared edges of a watertight mesh
+  are then rasterized exactly once. RM_Adaptive draws all triangles as blocks
+  while it is enabled. Default is false.
+  Vertex positions keep their full sub-pixel precision within +-2^19
+  pixels. Blocks of triangles with edges spanning more than about 500000
+  pixels are evaluated in 64 bit, which is slower but exact. */
+SR_API void Rasterizer_setFixedPoint(Rasterizer *r, bool enable);
+/// Set the pixel shader.
+/** Selects pixel loops compiled for the interpolation settings of ps. They
+  are selected again at the next draw after PixelShader_setPerspectiveStep. */
 SR_API void Rasterizer_setPixelShader(Rasterizer *r, PixelShader *ps);
+
+/// Set the render target written by batch pixel shaders.
+/** After the batch callback returns the covered lanes of PixelBatch::color
+  (or z for RTF_D32F targets) are stored. NULL disables the writes. RTF_D32F
+  targets are only written by pixel shaders that interpolate z. */
+SR_API void Rasterizer_setRenderTarget(Rasterizer *r, RenderTarget *rt);
+
+/// Set how batch results are combined with the render target.
+/** Default is BM_Opaque. R32F targets blend their single channel using the
+  alpha of the batch and are not clamped to [0, 1]. D32F targets always store
+  z unblended. Pixels drawn through PixelShader::drawPixel are not affected. */
+SR_API void Rasterizer_setBlendMode(Rasterizer *r, BlendMode mode);
+/// Set the channels of the render target that may be written.
+/** mask is a combination of the CWM_ flags and defaults to CWM_All. R32F
+  targets only use CWM_Red. */
+SR_API void Rasterizer_setColorWriteMask(Rasterizer *r, int mask);
+
+/// Enable the depth test against the depth buffer owned by the rasterizer.
+/** Pixels pass if their z is less than the stored depth. The test runs
+  before the pixel shader and whole blocks are rejected early using the
+  per block maximum depth. The buffer covers the scissor rect. Default is false. */
+SR_API void Rasterizer_setDepthTest(Rasterizer *r, bool enable);
+
+/// Clear the depth buffer owned by the rasterizer.
+SR_API void Rasterizer_clearDepth(Rasterizer *r, float depth);
+
+/// Enable the visibility buffer mode.
+/** Triangles are then only rasterized into a visibility buffer holding the
+  id of the triangle seen in each pixel, using the depth test if it is
+  enabled. No varyings are set up and no pixel shader runs until
+  Rasterizer_resolveVisibility. The vertices are copied so the arrays can be
+  reused right after drawing. Points and lines are recorded too and drawn on
+  top of the triangles in submission order when resolving, since they have no
+  depth test. Only the front-most triangle of each pixel is kept, so
+  translucent triangles hide what is behind them: draw them with the mode
+  disabled after resolving. Blending with the render target still applies
+  when resolving. Default is false. */
+SR_API void Rasterizer_setVisibilityMode(Rasterizer *r, bool enable);
+
+/// Shade the pixels recorded in the visibility buffer mode.
+/** Sets up the equations of the triangle seen in each pixel again and runs
+  the pixel shader that was set when it was drawn exactly once per pixel,
+  writing to the current render target. Clears the visibility buffer and the
+  recorded triangles afterwards. */
+SR_API void Rasterizer_resolveVisibility(Rasterizer *r);
 SR_API void Rasterizer_drawPoint(Rasterizer *r, const RasterizerVertex *v);
 SR_API void Rasterizer_drawLine(Rasterizer *r, const RasterizerVertex *v0, const RasterizerVertex *v1);
 SR_API void Rasterizer_drawTriangle(Rasterizer *r, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2);
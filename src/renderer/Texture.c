@@ -0,0 +1,569 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "Texture.h"
+#include "Memory.h"
+#include "Atomic.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SR_X86
+#endif
+
+#if defined(SR_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SR_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Largest float below 1. Wrapped coordinates are clamped to [0, TextureMaxCoord].
+static const float TextureMaxCoord = 0.99999994f;
+
+/// Entries of the per thread cache of decoded blocks.
+enum { TextureCacheSize = 64 };
+
+typedef struct TextureCacheEntry {
+    const uint32_t *block;
+    long generation;
+    uint32_t texels[TextureTileSize * TextureTileSize];
+} TextureCacheEntry;
+
+static THREAD_LOCAL TextureCacheEntry t_blockCache[TextureCacheSize];
+
+// Texels of the 1x1 level used when the texture memory can not be allocated.
+static uint32_t g_emptyTile[TextureTileSize * TextureTileSize];
+
+// Source of the level generations, so no cached block outlives an upload.
+static volatile long g_textureGeneration;
+
+static void Texture_touch(Texture *tex)
+{
+    long generation = Atomic_add(&g_textureGeneration, 1);
+    for (int i = 0; i < tex->m_levelCount; ++i)
+        tex->m_levels[i].generation = generation;
+}
+
+void Texture_construct(Texture *tex, TextureFormat format, int width, int height)
+{
+    tex->m_format = format;
+    tex->m_width = width;
+    tex->m_height = height;
+    tex->m_levelCount = 0;
+
+    size_t size = 0;
+    int w = width, h = height;
+
+    for (;;)
+    {
+        TextureLevel *level = &tex->m_levels[tex->m_levelCount++];
+        level->width = w;
+        level->height = h;
+        level->tilesX = (w + TextureTileSize - 1) / TextureTileSize;
+        level->tilesY = (h + TextureTileSize - 1) / TextureTileSize;
+        level->tileWords = format == TXF_BC1 ? 2 : (format == TXF_BC3 ? 4 : TextureTileSize * TextureTileSize);
+        level->format = format;
+        level->data = (uint32_t*)size;
+        size += (size_t)level->tilesX * level->tilesY * level->tileWords;
+
+        if ((w == 1 && h == 1) || tex->m_levelCount == MaxTextureLevels)
+            break;
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    // All levels share one allocation, the pointers are offsets until here.
+    tex->m_data = Memory_alignedAlloc(size * sizeof(uint32_t), 64);
+    if (!tex->m_data)
+    {
+        // Keep a single black level so sampling needs no checks.
+        TextureLevel *level = &tex->m_levels[0];
+        level->width = level->height = 1;
+        level->tilesX = level->tilesY = 1;
+        level->data = g_emptyTile;
+        tex->m_width = tex->m_height = 1;
+        tex->m_levelCount = 1;
+        Texture_touch(tex);
+        return;
+    }
+
+    memset(tex->m_data, 0, size * sizeof(uint32_t));
+
+    for (int i = 0; i < tex->m_levelCount; ++i)
+        tex->m_levels[i].data = (uint32_t*)tex->m_data + (size_t)tex->m_levels[i].data;
+
+    Texture_touch(tex);
+}
+
+void Texture_destruct(Texture *tex)
+{
+    Memory_alignedFree(tex->m_data);
+    tex->m_data = 0;
+}
+
+int Texture_width(const Texture *tex)
+{
+    return tex->m_width;
+}
+
+int Texture_height(const Texture *tex)
+{
+    return tex->m_height;
+}
+
+int Texture_levelCount(const Texture *tex)
+{
+    return tex->m_levelCount;
+}
+
+TextureFormat Texture_format(const Texture *tex)
+{
+    return tex->m_format;
+}
+
+// Average of four texels per channel, rounded.
+static inline uint32_t Texture_average(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    const uint32_t m = 0x00FF00FF;
+    uint32_t rb = (a & m) + (b & m) + (c & m) + (d & m) + 0x00020002;
+    uint32_t ag = ((a >> 8) & m) + ((b >> 8) & m) + ((c >> 8) & m) + ((d >> 8) & m) + 0x00020002;
+    return ((rb >> 2) & m) | ((ag << 6) & ~m);
+}
+
+void Texture_setImage(Texture *tex, const void *data, int pitch)
+{
+    if (tex->m_format != TXF_RGBA8 || !tex->m_data)
+        return;
+
+    TextureLevel *base = &tex->m_levels[0];
+
+    for (int y = 0; y < base->height; ++y)
+    {
+        const uint32_t *row = (const uint32_t*)((const char*)data + (size_t)y * pitch);
+        for (int x = 0; x < base->width; ++x)
+            base->data[Texture_offset(base, x, y)] = row[x];
+    }
+
+    for (int i = 1; i < tex->m_levelCount; ++i)
+    {
+        const TextureLevel *src = &tex->m_levels[i - 1];
+        TextureLevel *dst = &tex->m_levels[i];
+
+        for (int y = 0; y < dst->height; ++y)
+        {
+            int y0 = 2 * y < src->height ? 2 * y : src->height - 1;
+            int y1 = 2 * y + 1 < src->height ? 2 * y + 1 : src->height - 1;
+
+            for (int x = 0; x < dst->width; ++x)
+            {
+                int x0 = 2 * x < src->width ? 2 * x : src->width - 1;
+                int x1 = 2 * x + 1 < src->width ? 2 * x + 1 : src->width - 1;
+
+                dst->data[Texture_offset(dst, x, y)] = Texture_average(
+                    Texture_texel(src, x0, y0), Texture_texel(src, x1, y0),
+                    Texture_texel(src, x0, y1), Texture_texel(src, x1, y1));
+            }
+        }
+    }
+
+    Texture_touch(tex);
+}
+
+void Texture_setCompressedLevel(Texture *tex, int level, const void *blocks)
+{
+    if (tex->m_format == TXF_RGBA8 || !tex->m_data || level < 0 || level >= tex->m_levelCount)
+        return;
+
+    TextureLevel *l = &tex->m_levels[level];
+    memcpy(l->data, blocks, (size_t)l->tilesX * l->tilesY * l->tileWords * sizeof(uint32_t));
+
+    Texture_touch(tex);
+}
+
+static inline uint32_t Texture_packRGBA(int r, int g, int b, int a)
+{
+    uint8_t bytes[4] = { (uint8_t)r, (uint8_t)g, (uint8_t)b, (uint8_t)a };
+    uint32_t packed;
+    memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+}
+
+// Decode the color part of a BC1 or BC3 block. BC3 always uses four colors.
+static void Texture_decodeColors(const uint8_t *block, bool allowAlpha, uint32_t *texels)
+{
+    int c0 = block[0] | block[1] << 8;
+    int c1 = block[2] | block[3] << 8;
+
+    int rgb[4][3];
+    for (int i = 0; i < 2; ++i)
+    {
+        int c = i ? c1 : c0;
+        int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+        rgb[i][0] = r << 3 | r >> 2;
+        rgb[i][1] = g << 2 | g >> 4;
+        rgb[i][2] = b << 3 | b >> 2;
+    }
+
+    uint32_t palette[4];
+    bool fourColors = !allowAlpha || c0 > c1;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (fourColors)
+        {
+            rgb[2][k] = (2 * rgb[0][k] + rgb[1][k]) / 3;
+            rgb[3][k] = (rgb[0][k] + 2 * rgb[1][k]) / 3;
+        }
+        else
+        {
+            rgb[2][k] = (rgb[0][k] + rgb[1][k]) / 2;
+            rgb[3][k] = 0;
+        }
+    }
+    for (int i = 0; i < 4; ++i)
+        palette[i] = Texture_packRGBA(rgb[i][0], rgb[i][1], rgb[i][2], !fourColors && i == 3 ? 0 : 255);
+
+    uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+    for (int i = 0; i < 16; ++i)
+        texels[i] = palette[(indices >> (2 * i)) & 3];
+}
+
+// Decode the alpha part of a BC3 block into the alpha bytes of the texels.
+static void Texture_decodeAlpha(const uint8_t *block, uint32_t *texels)
+{
+    int a[8];
+    a[0] = block[0];
+    a[1] = block[1];
+    if (a[0] > a[1])
+    {
+        for (int i = 1; i < 7; ++i)
+            a[i + 1] = ((7 - i) * a[0] + i * a[1]) / 7;
+    }
+    else
+    {
+        for (int i = 1; i < 5; ++i)
+            a[i + 1] = ((5 - i) * a[0] + i * a[1]) / 5;
+        a[6] = 0;
+        a[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= (uint64_t)block[2 + i] << (8 * i);
+
+    for (int i = 0; i < 16; ++i)
+    {
+        uint8_t bytes[4];
+        memcpy(bytes, &texels[i], sizeof(bytes));
+        bytes[3] = (uint8_t)a[(indices >> (3 * i)) & 7];
+        memcpy(&texels[i], bytes, sizeof(bytes));
+    }
+}
+
+// Texel of a compressed level, decoding its block on a cache miss.
+static uint32_t Texture_compressedTexel(const TextureLevel *level, int x, int y)
+{
+    int tileX = x / TextureTileSize;
+    int tileY = y / TextureTileSize;
+    const uint32_t *block = level->data + (size_t)(tileY * level->tilesX + tileX) * level->tileWords;
+
+    // Neighboring blocks use different entries.
+    TextureCacheEntry *entry = &t_blockCache[(tileX & 7) | (tileY & 7) << 3];
+    if (entry->block != block || entry->generation != level->generation)
+    {
+        const uint8_t *bytes = (const uint8_t*)block;
+        if (level->format == TXF_BC3)
+        {
+            Texture_decodeColors(bytes + 8, false, entry->texels);
+            Texture_decodeAlpha(bytes, entry->texels);
+        }
+        else
+        {
+            Texture_decodeColors(bytes, true, entry->texels);
+        }
+        entry->block = block;
+        entry->generation = level->generation;
+    }
+
+    return entry->texels[(y % TextureTileSize) * TextureTileSize + x % TextureTileSize];
+}
+
+static inline uint32_t Texture_fetch(const TextureLevel *level, int x, int y)
+{
+    if (level->format != TXF_RGBA8)
+        return Texture_compressedTexel(level, x, y);
+    return Texture_texel(level, x, y);
+}
+
+// Interpolate each channel with a weight t in [0, 256].
+static inline uint32_t Texture_lerp(uint32_t a, uint32_t b, uint32_t t)
+{
+    const uint32_t m = 0x00FF00FF;
+    uint32_t rb = (((a & m) * (256 - t) + (b & m) * t) >> 8) & m;
+    uint32_t ag = (((a >> 8) & m) * (256 - t) + ((b >> 8) & m) * t) & ~m;
+    return rb | ag;
+}
+
+// Wrap a texture coordinate to [0, 1). NaN maps to 0.
+static inline float Texture_wrapCoord(float u)
+{
+    u -= floorf(u);
+    return u > 0.0f ? (u < TextureMaxCoord ? u : TextureMaxCoord) : 0.0f;
+}
+
+static inline int Texture_nearestLevel(const Texture *tex, float lod)
+{
+    if (!(lod > 0.5f))
+        return 0;
+    if (lod >= tex->m_levelCount - 1)
+        return tex->m_levelCount - 1;
+    return (int)(lod + 0.5f);
+}
+
+// Split lod into the first of the two levels to blend and the weight of the second one.
+static inline int Texture_trilinearLevel(const Texture *tex, float lod, uint32_t *t)
+{
+    *t = 0;
+    if (!(lod > 0.0f))
+        return 0;
+
+    float first = floorf(lod);
+    if (first >= tex->m_levelCount - 1)
+        return tex->m_levelCount - 1;
+
+    *t = (uint32_t)((lod - first) * 256.0f + 0.5f);
+    return (int)first;
+}
+
+static inline uint32_t Texture_nearest(const TextureLevel *level, float u, float v)
+{
+    int x = (int)(Texture_wrapCoord(u) * level->width);
+    int y = (int)(Texture_wrapCoord(v) * level->height);
+    return Texture_fetch(level, x < level->width ? x : level->width - 1, y < level->height ? y : level->height - 1);
+}
+
+// Texel to the left of the sample point and the weight of the one to its right.
+static inline void Texture_bilinearCoord(float u, int size, int *x0, int *x1, uint32_t *t)
+{
+    float f = Texture_wrapCoord(u) * size - 0.5f;
+    float fl = floorf(f);
+    *t = (uint32_t)((f - fl) * 256.0f + 0.5f);
+    *x0 = fl < 0.0f ? size - 1 : (int)fl;
+    *x1 = *x0 + 1 == size ? 0 : *x0 + 1;
+}
+
+static inline uint32_t Texture_bilinear(const TextureLevel *level, float u, float v)
+{
+    int x0, x1, y0, y1;
+    uint32_t tx, ty;
+    Texture_bilinearCoord(u, level->width, &x0, &x1, &tx);
+    Texture_bilinearCoord(v, level->height, &y0, &y1, &ty);
+
+    uint32_t top = Texture_lerp(Texture_fetch(level, x0, y0), Texture_fetch(level, x1, y0), tx);
+    uint32_t bottom = Texture_lerp(Texture_fetch(level, x0, y1), Texture_fetch(level, x1, y1), tx);
+    return Texture_lerp(top, bottom, ty);
+}
+
+uint32_t Texture_sample(const Texture *tex, TextureFilter filter, float u, float v, float lod)
+{
+    switch (filter)
+    {
+    case TF_Nearest:
+        return Texture_nearest(&tex->m_levels[Texture_nearestLevel(tex, lod)], u, v);
+    case TF_Bilinear:
+        return Texture_bilinear(&tex->m_levels[Texture_nearestLevel(tex, lod)], u, v);
+    case TF_Trilinear:
+    default:
+    {
+        uint32_t t;
+        int level = Texture_trilinearLevel(tex, lod, &t);
+        uint32_t c = Texture_bilinear(&tex->m_levels[level], u, v);
+        return t ? Texture_lerp(c, Texture_bilinear(&tex->m_levels[level + 1], u, v), t) : c;
+    }
+    }
+}
+
+float Texture_computeLod(const Texture *tex, float dudx, float dvdx, float dudy, float dvdy)
+{
+    float w = (float)tex->m_width;
+    float h = (float)tex->m_height;
+
+    float x2 = dudx * dudx * w * w + dvdx * dvdx * h * h;
+    float y2 = dudy * dudy * w * w + dvdy * dvdy * h * h;
+    float rho2 = x2 > y2 ? x2 : y2;
+
+    // log2 of the footprint length without the square root.
+    return rho2 > 0.0f ? 0.5f * log2f(rho2) : -FLT_MAX;
+}
+
+float Texture_pixelLod(const Texture *tex, const PixelData *p, int u, int v)
+{
+    float dudx, dudy, dvdx, dvdy;
+    PixelData_pvarDerivatives(p, u, &dudx, &dudy);
+    PixelData_pvarDerivatives(p, v, &dvdx, &dvdy);
+    return Texture_computeLod(tex, dudx, dvdx, dudy, dvdy);
+}
+
+float Texture_batchLod(const Texture *tex, const PixelBatch *batch, int u, int v, int lane)
+{
+    float dudx, dudy, dvdx, dvdy;
+    PixelBatch_pvarDerivatives(batch, u, lane, &dudx, &dudy);
+    PixelBatch_pvarDerivatives(batch, v, lane, &dvdx, &dvdy);
+    return Texture_computeLod(tex, dudx, dvdx, dudy, dvdy);
+}
+
+#ifdef SR_HAVE_SSE2
+// floorf for four lanes. Floats of magnitude 2^23 and above are already
+// integers and are passed through, as the conversion only covers an int.
+static inline __m128 Texture_floor4(__m128 f)
+{
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(f));
+    t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, f), _mm_set1_ps(1.0f)));
+
+    __m128 small = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), f), _mm_set1_ps(8388608.0f));
+    return _mm_or_ps(_mm_and_ps(small, t), _mm_andnot_ps(small, f));
+}
+
+// Same as Texture_bilinearCoord for four lanes with their own sizes.
+static inline void Texture_bilinearCoord4(__m128 u, __m128i size, __m128i *x0, __m128i *x1, __m128i *t)
+{
+    // Clamp the wrapped coordinate as Texture_wrapCoord does. max_ps returns
+    // the second operand for NaN.
+    u = _mm_sub_ps(u, Texture_floor4(u));
+    u = _mm_min_ps(_mm_max_ps(u, _mm_setzero_ps()), _mm_set1_ps(TextureMaxCoord));
+
+    __m128 f = _mm_sub_ps(_mm_mul_ps(u, _mm_cvtepi32_ps(size)), _mm_set1_ps(0.5f));
+    __m128 fl = Texture_floor4(f);
+    *t = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(f, fl), _mm_set1_ps(256.0f)), _mm_set1_ps(0.5f)));
+
+    __m128i one = _mm_set1_epi32(1);
+    __m128i i0 = _mm_cvttps_epi32(fl);
+    __m128i negative = _mm_cmplt_epi32(i0, _mm_setzero_si128());
+    i0 = _mm_or_si128(_mm_andnot_si128(negative, i0), _mm_and_si128(negative, _mm_sub_epi32(size, one)));
+
+    __m128i i1 = _mm_add_epi32(i0, one);
+    *x0 = i0;
+    *x1 = _mm_andnot_si128(_mm_cmpeq_epi32(i1, size), i1);
+}
+
+// Interpolate two pairs of texels unpacked to 16 bits.
+static inline __m128i Texture_lerp16(__m128i a, __m128i b, __m128i t)
+{
+    __m128i s = _mm_sub_epi16(_mm_set1_epi16(256), t);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, s), _mm_mullo_epi16(b, t)), 8);
+}
+
+// Expand the weights of lanes 0, 1 (or 2, 3) to the channels of the unpacked texels.
+static inline __m128i Texture_weights16(__m128i t, int hi)
+{
+    __m128i w = _mm_packs_epi32(t, t);
+    w = _mm_unpacklo_epi16(w, w);
+    return hi ? _mm_unpackhi_epi32(w, w) : _mm_unpacklo_epi32(w, w);
+}
+
+// Same as Texture_lerp for four texels with their own weights.
+static inline __m128i Texture_lerp4(__m128i a, __m128i b, __m128i t)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = Texture_lerp16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), Texture_weights16(t, 0));
+    __m128i hi = Texture_lerp16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), Texture_weights16(t, 1));
+    return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i Texture_bilinear4(const Texture *tex, const int *levels, const float *u, const float *v)
+{
+    const TextureLevel *l[4];
+    for (int i = 0; i < 4; ++i)
+        l[i] = &tex->m_levels[levels[i]];
+
+    __m128i width = _mm_setr_epi32(l[0]->width, l[1]->width, l[2]->width, l[3]->width);
+    __m128i height = _mm_setr_epi32(l[0]->height, l[1]->height, l[2]->height, l[3]->height);
+
+    __m128i x0, x1, y0, y1, tx, ty;
+    Texture_bilinearCoord4(_mm_loadu_ps(u), width, &x0, &x1, &tx);
+    Texture_bilinearCoord4(_mm_loadu_ps(v), height, &y0, &y1, &ty);
+
+    int32_t ix0[4], ix1[4], iy0[4], iy1[4];
+    _mm_storeu_si128((__m128i*)ix0, x0);
+    _mm_storeu_si128((__m128i*)ix1, x1);
+    _mm_storeu_si128((__m128i*)iy0, y0);
+    _mm_storeu_si128((__m128i*)iy1, y1);
+
+    // The texel loads are scalar, the filtering is done for all lanes at once.
+    uint32_t c00[4], c10[4], c01[4], c11[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        c00[i] = Texture_fetch(l[i], ix0[i], iy0[i]);
+        c10[i] = Texture_fetch(l[i], ix1[i], iy0[i]);
+        c01[i] = Texture_fetch(l[i], ix0[i], iy1[i]);
+        c11[i] = Texture_fetch(l[i], ix1[i], iy1[i]);
+    }
+
+    __m128i top = Texture_lerp4(_mm_loadu_si128((const __m128i*)c00), _mm_loadu_si128((const __m128i*)c10), tx);
+    __m128i bottom = Texture_lerp4(_mm_loadu_si128((const __m128i*)c01), _mm_loadu_si128((const __m128i*)c11), tx);
+    return Texture_lerp4(top, bottom, ty);
+}
+#endif
+
+void Texture_sample4(const Texture *tex, TextureFilter filter, const float *u, const float *v, const float *lod, uint32_t *out)
+{
+#ifdef SR_HAVE_SSE2
+    if (filter != TF_Nearest)
+    {
+        int levels[4];
+        uint32_t t[4] = { 0, 0, 0, 0 };
+
+        for (int i = 0; i < 4; ++i)
+        {
+            float l = lod ? lod[i] : 0.0f;
+            levels[i] = filter == TF_Bilinear ? Texture_nearestLevel(tex, l) : Texture_trilinearLevel(tex, l, &t[i]);
+        }
+
+        __m128i c = Texture_bilinear4(tex, levels, u, v);
+
+        if (t[0] | t[1] | t[2] | t[3])
+        {
+            // Lanes without a second level blend with weight 0.
+            for (int i = 0; i < 4; ++i)
+                levels[i] += t[i] ? 1 : 0;
+            __m128i c1 = Texture_bilinear4(tex, levels, u, v);
+            c = Texture_lerp4(c, c1, _mm_loadu_si128((const __m128i*)t));
+        }
+
+        _mm_storeu_si128((__m128i*)out, c);
+        return;
+    }
+#endif
+
+    for (int i = 0; i < 4; ++i)
+        out[i] = Texture_sample(tex, filter, u[i], v[i], lod ? lod[i] : 0.0f);
+}
+
+void Texture_sample8(const Texture *tex, TextureFilter filter, const float *u, const float *v, const float *lod, uint32_t *out)
+{
+    Texture_sample4(tex, filter, u, v, lod, out);
+    Texture_sample4(tex, filter, u + 4, v + 4, lod ? lod + 4 : 0, out + 4);
+}
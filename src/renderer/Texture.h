@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "Renderer.h"
+
+#include <stdint.h>
+
+enum {
+    /// Texels per side of the tiles a texture level is stored in.
+    TextureTileSize = 4,
+    /// Enough levels for textures up to 32768 x 32768.
+    MaxTextureLevels = 16
+};
+
+/// One level of the mip chain.
+typedef struct TextureLevel {
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+
+	// Size of a tile in 32 bit words: 16 texels or one compressed block.
+	int tileWords;
+	TextureFormat format;
+	// Changes whenever the contents change. Tags the decoded blocks.
+	long generation;
+
+	uint32_t *data;
+} TextureLevel;
+
+/// Texture with a mip chain stored in 4x4 texel tiles.
+/** The tiles of a level are stored in row major order and the texels of a
+  tile are contiguous and row major, so a tile is exactly one 64 byte cache
+  line and a bilinear footprint touches one to four lines no matter how the
+  texture is oriented on screen. Texels are 32 bit with four 8 bit channels
+  in any order; the samplers filter each byte independently.
+
+  Compressed formats store one BC block per tile. The samplers decode the
+  blocks they touch into a small per thread cache. */
+typedef struct Texture_s {
+	TextureFormat m_format;
+	int m_width;
+	int m_height;
+	int m_levelCount;
+	TextureLevel m_levels[MaxTextureLevels];
+
+	void *m_data;
+} Texture;
+
+void Texture_construct(Texture *tex, TextureFormat format, int width, int height);
+void Texture_destruct(Texture *tex);
+
+/// Offset in texels of (x, y) from the start of the level.
+static inline int Texture_offset(const TextureLevel *level, int x, int y)
+{
+    int tile = (y / TextureTileSize) * level->tilesX + x / TextureTileSize;
+    return tile * TextureTileSize * TextureTileSize + (y % TextureTileSize) * TextureTileSize + x % TextureTileSize;
+}
+
+/// Texel of an uncompressed level.
+static inline uint32_t Texture_texel(const TextureLevel *level, int x, int y)
+{
+    return level->data[Texture_offset(level, x, y)];
+}
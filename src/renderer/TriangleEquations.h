@@ -26,41 +26,99 @@ SOFTWARE.
 
 #include "ParameterEquation.h"
 
-typedef struct {
+typedef struct TriangleEquations_s {
 	float area2;
+	float factor;
 
 	EdgeEquation e0;
 	EdgeEquation e1;
 	EdgeEquation e2;
 
+	// Only set up in fixed point mode.
+	FixedEdgeEquation f0;
+	FixedEdgeEquation f1;
+	FixedEdgeEquation f2;
+	// False if an edge is too long for the 32 bit block kernels.
+	bool fixedFitsBlock;
+
 	ParameterEquation z;
 	ParameterEquation invw;
 	ParameterEquation avar[MaxAVars];
 	ParameterEquation pvar[MaxPVars];
+
+	// Index of the recorded triangle in the visibility buffer mode.
+	uint32_t id;
 } TriangleEquations;
 
-static inline void TriangleEquations_construct(TriangleEquations *te, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, int aVarCount, int pVarCount)
+// Set up the edge equations only. This is all that is needed to compute coverage.
+static inline void TriangleEquations_constructEdges(TriangleEquations *te, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
 {
     EdgeEquation_init(&te->e0, v1, v2);
     EdgeEquation_init(&te->e1, v2, v0);
     EdgeEquation_init(&te->e2, v0, v1);
 
     te->area2 = te->e0.c + te->e1.c + te->e2.c;
+    te->factor = te->area2 > 0 ? 1.0f / te->area2 : 0.0f;
+}
 
-    // Cull backfacing triangles.
-    if (te->area2 <= 0)
-        return;
+// Set up the depth equation. Requires the edge equations.
+static inline void TriangleEquations_constructDepth(TriangleEquations *te, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+{
+    ParameterEquation_init(&te->z, v0->z, v1->z, v2->z, &te->e0, &te->e1, &te->e2, te->factor);
+}
 
-    float factor = 1.0f / te->area2;
-    ParameterEquation_init(&te->z, v0->z, v1->z, v2->z, &te->e0, &te->e1, &te->e2, factor);
+// Set up the 1/w and varying equations. Requires the edge equations.
+// The perspective variables of the vertices start pvarOffset floats after x.
+static inline void TriangleEquations_constructParams(TriangleEquations *te, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, bool interpolateW, int aVarCount, int pVarCount, int pvarOffset)
+{
+    float factor = te->factor;
+
+    for (int i = 0; i < aVarCount; ++i)
+        ParameterEquation_init(&te->avar[i], v0->avar[i], v1->avar[i], v2->avar[i], &te->e0, &te->e1, &te->e2, factor);
+
+    if (!interpolateW && pVarCount == 0)
+        return;
 
     float invw0 = 1.0f / v0->w;
     float invw1 = 1.0f / v1->w;
     float invw2 = 1.0f / v2->w;
 
     ParameterEquation_init(&te->invw, invw0, invw1, invw2, &te->e0, &te->e1, &te->e2, factor);
-    for (int i = 0; i < aVarCount; ++i)
-        ParameterEquation_init(&te->avar[i], v0->avar[i], v1->avar[i], v2->avar[i], &te->e0, &te->e1, &te->e2, factor);
+    const float *pvar0 = (const float*)v0 + pvarOffset;
+    const float *pvar1 = (const float*)v1 + pvarOffset;
+    const float *pvar2 = (const float*)v2 + pvarOffset;
     for (int i = 0; i < pVarCount; ++i)
-        ParameterEquation_init(&te->pvar[i], v0->pvar[i] * invw0, v1->pvar[i] * invw1, v2->pvar[i] * invw2, &te->e0, &te->e1, &te->e2, factor);
-}
\ No newline at end of file
+        ParameterEquation_init(&te->pvar[i], pvar0[i] * invw0, pvar1[i] * invw1, pvar2[i] * invw2, &te->e0, &te->e1, &te->e2, factor);
+}
+
+// The perspective variables of the vertices start pvarOffset floats after x.
+static inline void TriangleEquations_construct(TriangleEquations *te, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2, int aVarCount, int pVarCount, int pvarOffset)
+{
+    TriangleEquations_constructEdges(te, v0, v1, v2);
+
+    // Cull backfacing triangles.
+    if (te->area2 <= 0)
+        return;
+
+    TriangleEquations_constructDepth(te, v0, v1, v2);
+    TriangleEquations_constructParams(te, v0, v1, v2, true, aVarCount, pVarCount, pvarOffset);
+}
+
+// Set up the fixed point edge equations. Returns false if the snapped
+// triangle is backfacing or degenerate.
+static inline bool TriangleEquations_constructFixed(TriangleEquations *te, const RasterizerVertex *v0, const RasterizerVertex *v1, const RasterizerVertex *v2)
+{
+    int64_t x0 = FixedEdgeEquation_snap(v0->x), y0 = FixedEdgeEquation_snap(v0->y);
+    int64_t x1 = FixedEdgeEquation_snap(v1->x), y1 = FixedEdgeEquation_snap(v1->y);
+    int64_t x2 = FixedEdgeEquation_snap(v2->x), y2 = FixedEdgeEquation_snap(v2->y);
+
+    int64_t area2 = FixedEdgeEquation_init(&te->f0, x1, y1, x2, y2)
+        + FixedEdgeEquation_init(&te->f1, x2, y2, x0, y0)
+        + FixedEdgeEquation_init(&te->f2, x0, y0, x1, y1);
+
+    te->fixedFitsBlock = FixedEdgeEquation_fitsBlock(&te->f0)
+        && FixedEdgeEquation_fitsBlock(&te->f1)
+        && FixedEdgeEquation_fitsBlock(&te->f2);
+
+    return area2 > 0;
+}
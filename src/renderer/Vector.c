@@ -1,5 +1,5 @@
 
-#include "vector.h"
+#include "Vector.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,8 +14,8 @@ void Vector_init(Vector *vector, int elem_size) {
 
 void Vector_delete(Vector *vector, int index) {
     char *data = (char*)vector->data;
-    memmove((void*)data[index * vector->elem_size],
-        (void*)data[(index + 1) * vector->elem_size],
+    memmove(&data[index * vector->elem_size],
+        &data[(index + 1) * vector->elem_size],
         (vector->size - index - 1) * vector->elem_size);
 
     vector->size = vector->size - 1;
@@ -29,13 +29,14 @@ void Vector_set_size(Vector *vector, int size)
     // set all new elements to zero
     if (size > oldSize) {
         char *data = vector->data;
-        memset(&data[oldSize * vector->elem_size], 0, size - oldSize);
+        memset(&data[oldSize * vector->elem_size], 0, (size - oldSize) * vector->elem_size);
     }
 }
 
 void Vector_resize(Vector *vector) {
     if (vector->size >= vector->capacity) {
-        vector->capacity *= 2;
+        while (vector->size >= vector->capacity)
+            vector->capacity *= 2;
         vector->data = realloc(vector->data, vector->elem_size * vector->capacity);
     }
 }
@@ -51,6 +52,18 @@ void Vector_swap(Vector *first, Vector *second)
     *second = tmp;
 }
 
+void Vector_set_elem_size(Vector *vector, int elem_size)
+{
+    int bytes = vector->elem_size * vector->capacity;
+    vector->elem_size = elem_size;
+    vector->size = 0;
+    vector->capacity = bytes / elem_size;
+    if (vector->capacity < VECTOR_INITIAL_CAPACITY) {
+        vector->capacity = VECTOR_INITIAL_CAPACITY;
+        vector->data = realloc(vector->data, elem_size * vector->capacity);
+    }
+}
+
 int Vector_size(Vector *vector) {
     return vector->size;
 }
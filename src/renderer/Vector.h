@@ -18,6 +18,8 @@ void Vector_set_size(Vector *vector, int size);
 void Vector_resize(Vector *vector);
 void Vector_clear(Vector *vector);
 void Vector_swap(Vector *first, Vector *second);
+/// Change the element size. Clears the vector.
+void Vector_set_elem_size(Vector *vector, int elem_size);
 
 int Vector_size(Vector *vector);
 int Vector_capacity(Vector *vector);
@@ -26,15 +28,22 @@ bool Vector_is_empty(Vector *vector);
 
 #define Vector_element(vector,index,type) ((type*)((Vector*)vector)->data)[index]
 
+/// Pointer to an element using the runtime element size.
+#define Vector_at(vector,index) ((void*)((char*)((Vector*)vector)->data + (index) * ((Vector*)vector)->elem_size))
+
 #define Vector_set(vector,index,value,type) Vector_element(vector,index,type) = value
 
 #define Vector_append(vector,value,type) \
-    Vector_resize(vector); \
-    Vector_set(vector,((Vector*)vector)->size++,value,type)
+    do { \
+        Vector_resize(vector); \
+        Vector_set(vector,((Vector*)vector)->size++,value,type); \
+    } while (0)
 
 #define Vector_prepend(vector,value,type) \
-    Vector_set(vector,0,value,type); \
-    vector->size++;
+    do { \
+        Vector_set(vector,0,value,type); \
+        (vector)->size++; \
+    } while (0)
 
 #define Vector_pop(vector,type) \
     Vector_element(vector, --((Vector*)vector)->size, type) \
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #pragma once
 
+#include <stdlib.h>
+
 enum { VertexCacheSize = 16 };
 typedef struct VertexCache {
 	int inputIndex[VertexCacheSize];
@@ -56,3 +58,86 @@ static inline int VertexCache_lookup(VertexCache *vc, int inIndex)
     else
         return -1;
 }
+
+/// Hash table that remembers every vertex transformed in the current batch.
+/** Entries are tagged with a generation so clearing only bumps the counter. */
+typedef struct VertexHashCache {
+	int *inputIndex;
+	int *outputIndex;
+	unsigned *generation;
+	int capacity;
+	unsigned currentGeneration;
+} VertexHashCache;
+
+static inline void VertexHashCache_construct(VertexHashCache *vc)
+{
+    vc->inputIndex = 0;
+    vc->outputIndex = 0;
+    vc->generation = 0;
+    vc->capacity = 0;
+    vc->currentGeneration = 1;
+}
+
+static inline void VertexHashCache_destruct(VertexHashCache *vc)
+{
+    free(vc->inputIndex);
+    free(vc->outputIndex);
+    free(vc->generation);
+    VertexHashCache_construct(vc);
+}
+
+/// Make room for at least count entries per generation. Clears the cache.
+static inline void VertexHashCache_reserve(VertexHashCache *vc, int count)
+{
+    // Keep the load factor at or below one half.
+    int capacity = 64;
+    while (capacity < 2 * count)
+        capacity *= 2;
+
+    if (capacity <= vc->capacity)
+        return;
+
+    VertexHashCache_destruct(vc);
+    vc->inputIndex = malloc(sizeof(int) * capacity);
+    vc->outputIndex = malloc(sizeof(int) * capacity);
+    vc->generation = calloc(capacity, sizeof(unsigned));
+    vc->capacity = capacity;
+}
+
+static inline void VertexHashCache_clear(VertexHashCache *vc)
+{
+    if (++vc->currentGeneration == 0)
+    {
+        for (int i = 0; i < vc->capacity; i++)
+            vc->generation[i] = 0;
+        vc->currentGeneration = 1;
+    }
+}
+
+static inline int VertexHashCache_slot(const VertexHashCache *vc, int inIndex)
+{
+    return (int)(((unsigned)inIndex * 2654435761u) & (unsigned)(vc->capacity - 1));
+}
+
+static inline void VertexHashCache_set(VertexHashCache *vc, int inIndex, int outIndex)
+{
+    int slot = VertexHashCache_slot(vc, inIndex);
+    while (vc->generation[slot] == vc->currentGeneration && vc->inputIndex[slot] != inIndex)
+        slot = (slot + 1) & (vc->capacity - 1);
+
+    vc->generation[slot] = vc->currentGeneration;
+    vc->inputIndex[slot] = inIndex;
+    vc->outputIndex[slot] = outIndex;
+}
+
+static inline int VertexHashCache_lookup(const VertexHashCache *vc, int inIndex)
+{
+    int slot = VertexHashCache_slot(vc, inIndex);
+    while (vc->generation[slot] == vc->currentGeneration)
+    {
+        if (vc->inputIndex[slot] == inIndex)
+            return vc->outputIndex[slot];
+        slot = (slot + 1) & (vc->capacity - 1);
+    }
+    return -1;
+}
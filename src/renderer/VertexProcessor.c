@@ -23,8 +23,66 @@ SOFTWARE.
 */
 
 #include "VertexProcessor.h"
+#include "JobSystem.h"
 
 #include <assert.h>
+#include <math.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// Assumed L2 size when it can not be queried.
+enum { DefaultL2CacheSize = 256 * 1024 };
+
+static long l2CacheSize()
+{
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+	long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (size > 0)
+		return size;
+#endif
+	return DefaultL2CacheSize;
+}
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+/// Chunks in flight per thread in streaming mode.
+enum { StreamSlotsPerThread = 2 };
+
+/// Smallest number of vertices or triangles handed to a job.
+enum { VertexGrain = 64, TriangleGrain = 128 };
+
+// Chunks of one wave of the parallel front end.
+typedef struct FrontEndJob {
+	VertexProcessor *vp;
+	DrawMode mode;
+	const int *indices;
+	unsigned long count;
+	unsigned long chunkSize;
+	int firstChunk;
+} FrontEndJob;
+
+// A chunk of the streaming front end. The consumer waits on done.
+typedef struct StreamSlot {
+	VertexProcessor *processor;
+	JobCounter done;
+	DrawMode mode;
+	const int *indices;
+	unsigned long first;
+	unsigned long last;
+} StreamSlot;
+
+typedef struct ClipMaskJob {
+	VertexProcessor *vp;
+	bool guardBand;
+} ClipMaskJob;
 
 static inline void swapIntegers(int *first, int *second)
 {
@@ -40,11 +98,27 @@ void VertexProcessor_construct(VertexProcessor *vp, Rasterizer *rasterizer)
     Vector_init(&vp->m_indicesOut, sizeof(int));
     Vector_init(&vp->m_clipMask, sizeof(int));
     Vector_init(&vp->m_alreadyProcessed, sizeof(bool));
+    Vector_init(&vp->m_pendingVertices, sizeof(int));
+    Vector_init(&vp->m_chunkProcessors, sizeof(VertexProcessor*));
+    Vector_init(&vp->m_streamSlots, sizeof(StreamSlot));
+    vp->m_parallelFrontEnd = true;
+    vp->m_streaming = false;
 
     PolyClipper_construct(&vp->m_polyClipper);
 
+    VertexCache_construct(&vp->m_vertexCache);
+    VertexHashCache_construct(&vp->m_vertexHashCache);
+    Vector_init(&vp->m_carryIndices, sizeof(int));
+    Vector_init(&vp->m_carryVertices, sizeof(VertexShaderOutput));
+    vp->m_vertexCacheMode = VCM_DirectMapped;
+    // Full vertices until the layout is derived from the pixel shader.
+    vp->m_vertexSize = sizeof(VertexShaderOutput) / sizeof(float);
+    VertexProcessor_setBatchSize(vp, DefaultBatchSize);
+    VertexProcessor_resetVertexCacheStats(vp);
+
     VertexProcessor_setRasterizer(vp, rasterizer);
     VertexProcessor_setCullMode(vp, CM_CW);
+    VertexProcessor_setGuardBand(vp, 1.0f, 1.0f);
     VertexProcessor_setDepthRange(vp, 0.0f, 1.0f);
     VertexProcessor_setVertexShader(vp, 0/*NULL*/);
 }
@@ -55,8 +129,21 @@ void VertexProcessor_destruct(VertexProcessor *vp)
     Vector_free(&vp->m_indicesOut);
     Vector_free(&vp->m_clipMask);
     Vector_free(&vp->m_alreadyProcessed);
+    Vector_free(&vp->m_pendingVertices);
+
+    for (int i = 0; i < Vector_size(&vp->m_chunkProcessors); ++i)
+    {
+        VertexProcessor *chunk = Vector_element(&vp->m_chunkProcessors, i, VertexProcessor*);
+        VertexProcessor_destruct(chunk);
+        free(chunk);
+    }
+    Vector_free(&vp->m_chunkProcessors);
+    Vector_free(&vp->m_streamSlots);
 
     PolyClipper_destruct(&vp->m_polyClipper);
+    VertexHashCache_destruct(&vp->m_vertexHashCache);
+    Vector_free(&vp->m_carryIndices);
+    Vector_free(&vp->m_carryVertices);
 }
 
 void VertexProcessor_setRasterizer(VertexProcessor *vp, Rasterizer *rasterizer)
@@ -76,6 +163,8 @@ void VertexProcessor_setViewport(VertexProcessor *vp, int x, int y, int width, i
 	vp->m_viewport.py = height / 2.0f;
 	vp->m_viewport.ox = (x + vp->m_viewport.px);
 	vp->m_viewport.oy = (y + vp->m_viewport.py);
+
+	VertexProcessor_updateGuardBand(vp);
 }
 
 void VertexProcessor_setDepthRange(VertexProcessor *vp, float n, float f)
@@ -84,6 +173,34 @@ void VertexProcessor_setDepthRange(VertexProcessor *vp, float n, float f)
 	vp->m_depthRange.f = f;
 }
 
+void VertexProcessor_setGuardBand(VertexProcessor *vp, float x, float y)
+{
+	vp->m_guardBand.requestX = x > 1.0f ? x : 1.0f;
+	vp->m_guardBand.requestY = y > 1.0f ? y : 1.0f;
+	VertexProcessor_updateGuardBand(vp);
+}
+
+static float guardBandLimit(float request, float half, float center)
+{
+	if (request <= 1.0f || half <= 0.0f)
+		return 1.0f;
+
+	float limit = (MaxGuardBandCoord - fabsf(center)) / half;
+	if (request > limit) request = limit;
+	return request > 1.0f ? request : 1.0f;
+}
+
+void VertexProcessor_updateGuardBand(VertexProcessor *vp)
+{
+	vp->m_guardBand.x = guardBandLimit(vp->m_guardBand.requestX, vp->m_viewport.px, vp->m_viewport.ox);
+	vp->m_guardBand.y = guardBandLimit(vp->m_guardBand.requestY, vp->m_viewport.py, vp->m_viewport.oy);
+}
+
+bool VertexProcessor_guardBandEnabled(const VertexProcessor *vp)
+{
+	return vp->m_guardBand.x > 1.0f || vp->m_guardBand.y > 1.0f;
+}
+
 void VertexProcessor_setCullMode(VertexProcessor *vp, CullMode mode)
 {
 	vp->m_cullMode = mode;
@@ -92,12 +209,71 @@ void VertexProcessor_setCullMode(VertexProcessor *vp, CullMode mode)
 void VertexProcessor_setVertexShader(VertexProcessor *vp, VertexShader *vs)
 {
     vp->m_vertexShader = vs;
+    vp->m_processVertexBatchFunc = 0;
     if (!vp->m_vertexShader)
         return;
 
     assert(vs->AttribCount <= MaxVertexAttribs);
     vp->m_attribCount = vp->m_vertexShader->AttribCount;
     vp->m_processVertexFunc = vs->processVertex;
+    vp->m_processVertexBatchFunc = vs->processVertexBatch;
+}
+
+void VertexProcessor_setVertexCacheMode(VertexProcessor *vp, VertexCacheMode mode)
+{
+    vp->m_vertexCacheMode = mode;
+
+    // A batch holds up to three new vertices per primitive plus the carried ones.
+    if (mode == VCM_Full)
+        VertexHashCache_reserve(&vp->m_vertexHashCache, 3 * vp->m_batchSize + VertexCarryWindow);
+}
+
+void VertexProcessor_setBatchSize(VertexProcessor *vp, int primitives)
+{
+    vp->m_autoBatchSize = primitives <= 0;
+    if (vp->m_autoBatchSize)
+        primitives = VertexProcessor_autoBatchSize(vp);
+
+    vp->m_batchSize = primitives;
+    VertexProcessor_setVertexCacheMode(vp, vp->m_vertexCacheMode);
+}
+
+int VertexProcessor_autoBatchSize(const VertexProcessor *vp)
+{
+    // Keep the packed output vertices, indices and clip masks of a batch
+    // within half of the L2, assuming no reuse.
+    long bytesPerPrimitive = 3 * (vp->m_vertexSize * sizeof(float) + 2 * sizeof(int) + sizeof(bool));
+    long primitives = l2CacheSize() / 2 / bytesPerPrimitive;
+    if (primitives < MinAutoBatchSize) primitives = MinAutoBatchSize;
+    if (primitives > MaxAutoBatchSize) primitives = MaxAutoBatchSize;
+    return (int)primitives;
+}
+
+int VertexProcessor_batchSize(const VertexProcessor *vp)
+{
+    return vp->m_batchSize;
+}
+
+void VertexProcessor_vertexCacheStats(const VertexProcessor *vp, unsigned long *hits, unsigned long *misses)
+{
+    if (hits) *hits = vp->m_vertexCacheHits;
+    if (misses) *misses = vp->m_vertexCacheMisses;
+}
+
+void VertexProcessor_resetVertexCacheStats(VertexProcessor *vp)
+{
+    vp->m_vertexCacheHits = 0;
+    vp->m_vertexCacheMisses = 0;
+}
+
+void VertexProcessor_setParallelFrontEnd(VertexProcessor *vp, bool enable)
+{
+    vp->m_parallelFrontEnd = enable;
+}
+
+void VertexProcessor_setStreaming(VertexProcessor *vp, bool enable)
+{
+    vp->m_streaming = enable;
 }
 
 void VertexProcessor_setVertexAttribPointer(VertexProcessor *vp, int index, int stride, const void *buffer)
@@ -109,49 +285,224 @@ void VertexProcessor_setVertexAttribPointer(VertexProcessor *vp, int index, int
 
 void VertexProcessor_drawElements(VertexProcessor *vp, DrawMode mode, unsigned long count, int *indices)
 {
+	VertexProcessor_updateLayout(vp);
+
+	// Large draws are split into chunks that go through the front end in parallel.
+	unsigned long chunkSize = (unsigned long)vp->m_batchSize * VertexProcessor_verticesPerPrimitive(mode);
+	if (vp->m_parallelFrontEnd && JobSystem_threadCount() > 1 && count > chunkSize)
+	{
+		if (vp->m_streaming)
+			VertexProcessor_drawElementsStreaming(vp, mode, count, indices);
+		else
+			VertexProcessor_drawElementsParallel(vp, mode, count, indices);
+		return;
+	}
+
 	Vector_clear(&vp->m_verticesOut);
 	Vector_clear(&vp->m_indicesOut);
+	Vector_clear(&vp->m_pendingVertices);
 
-	// TODO: Max 1024 primitives per batch.
-	VertexCache vCache;
-    VertexCache_construct(&vCache);
+	VertexProcessor_cacheClear(vp);
 
 	for (unsigned long i = 0; i < count; i++)
 	{
-		int index = indices[i];
-		int outputIndex = VertexCache_lookup(&vCache, index);
-		
-		if (outputIndex != -1)
-		{
-			Vector_append(&vp->m_indicesOut, outputIndex, int);
-		}
-		else
-		{
-            VertexShaderInput vIn;
-            VertexProcessor_initVertexInput(vp, vIn, index);
+		VertexProcessor_addIndex(vp, indices[i]);
 
-			int outputIndex = Vector_size(&vp->m_verticesOut);
-			Vector_append(&vp->m_indicesOut, outputIndex, int);
-            Vector_set_size(&vp->m_verticesOut, Vector_size(&vp->m_verticesOut) + 1);
-			VertexShaderOutput *vOut = &Vector_back(&vp->m_verticesOut, VertexShaderOutput);
-			
-			VertexProcessor_processVertex(vp, vIn, vOut);
-
-			VertexCache_set(&vCache, index, outputIndex);
-		}
-
-		if (VertexProcessor_primitiveCount(vp, mode) >= 1024)
+		if (VertexProcessor_primitiveCount(vp, mode) >= vp->m_batchSize)
 		{
+			VertexProcessor_shadeVertices(vp);
+			VertexProcessor_saveCarry(vp, indices, i + 1);
 			VertexProcessor_processPrimitives(vp, mode);
 			Vector_clear(&vp->m_verticesOut);
 			Vector_clear(&vp->m_indicesOut);
-			VertexCache_clear(&vCache);
+			VertexProcessor_cacheClear(vp);
+			VertexProcessor_restoreCarry(vp);
 		}
 	}
 
+    VertexProcessor_shadeVertices(vp);
     VertexProcessor_processPrimitives(vp, mode);
 }
 
+void VertexProcessor_drawElementsParallel(VertexProcessor *vp, DrawMode mode, unsigned long count, const int *indices)
+{
+	unsigned long chunkSize = (unsigned long)vp->m_batchSize * VertexProcessor_verticesPerPrimitive(mode);
+	int chunkCount = (int)((count + chunkSize - 1) / chunkSize);
+
+	// One processor per thread so a wave keeps every thread busy.
+	int waveSize = JobSystem_threadCount();
+	VertexProcessor_reserveChunkProcessors(vp, waveSize);
+
+	for (int first = 0; first < chunkCount; first += waveSize)
+	{
+		int n = min(waveSize, chunkCount - first);
+
+		FrontEndJob job = { vp, mode, indices, count, chunkSize, first };
+		JobSystem_parallelFor(n, 1, VertexProcessor_frontEndJob, &job);
+
+		// Rasterize in submission order.
+		for (int i = 0; i < n; ++i)
+			VertexProcessor_drawPrimitives(Vector_element(&vp->m_chunkProcessors, i, VertexProcessor*), mode);
+	}
+
+	VertexProcessor_gatherChunkStats(vp, waveSize);
+}
+
+void VertexProcessor_frontEndJob(void *data, int begin, int end)
+{
+	const FrontEndJob *job = data;
+
+	for (int i = begin; i < end; ++i)
+	{
+		VertexProcessor *chunk = Vector_element(&job->vp->m_chunkProcessors, i, VertexProcessor*);
+
+		unsigned long first = (job->firstChunk + i) * job->chunkSize;
+		unsigned long last = min(first + job->chunkSize, job->count);
+
+		VertexProcessor_processChunk(chunk, job->mode, job->indices, first, last);
+	}
+}
+
+void VertexProcessor_drawElementsStreaming(VertexProcessor *vp, DrawMode mode, unsigned long count, const int *indices)
+{
+	unsigned long chunkSize = (unsigned long)vp->m_batchSize * VertexProcessor_verticesPerPrimitive(mode);
+	int chunkCount = (int)((count + chunkSize - 1) / chunkSize);
+
+	// Bounded ring of chunks: the workers fill the slots ahead while this
+	// thread rasterizes the oldest one.
+	int slotCount = StreamSlotsPerThread * JobSystem_threadCount();
+	VertexProcessor_reserveChunkProcessors(vp, slotCount);
+	Vector_set_size(&vp->m_streamSlots, slotCount);
+	StreamSlot *slots = vp->m_streamSlots.data;
+
+	for (int i = 0; i < slotCount; ++i)
+	{
+		slots[i].processor = Vector_element(&vp->m_chunkProcessors, i, VertexProcessor*);
+		slots[i].done.pending = 0;
+		slots[i].mode = mode;
+		slots[i].indices = indices;
+	}
+
+	for (int i = 0; i < min(slotCount, chunkCount); ++i)
+		VertexProcessor_submitChunk(&slots[i], i * chunkSize, min((i + 1) * chunkSize, count));
+
+	for (int i = 0; i < chunkCount; ++i)
+	{
+		StreamSlot *slot = &slots[i % slotCount];
+
+		// Runs the chunk itself or short jobs until the chunk is done. The
+		// waits of the rasterizer skip the queued chunks.
+		JobSystem_wait(&slot->done);
+		VertexProcessor_drawPrimitives(slot->processor, mode);
+
+		// Refill the slot with the next chunk that is not in flight.
+		unsigned long next = i + slotCount;
+		if (next < (unsigned long)chunkCount)
+			VertexProcessor_submitChunk(slot, next * chunkSize, min((next + 1) * chunkSize, count));
+	}
+
+	VertexProcessor_gatherChunkStats(vp, slotCount);
+}
+
+void VertexProcessor_submitChunk(StreamSlot *slot, unsigned long first, unsigned long last)
+{
+	slot->first = first;
+	slot->last = last;
+	JobSystem_submitBackground(&slot->done, VertexProcessor_streamJob, slot, 0, 1);
+}
+
+void VertexProcessor_streamJob(void *data, int begin, int end)
+{
+	StreamSlot *slot = data;
+	(void)begin;
+	(void)end;
+	VertexProcessor_processChunk(slot->processor, slot->mode, slot->indices, slot->first, slot->last);
+}
+
+void VertexProcessor_processChunk(VertexProcessor *chunk, DrawMode mode, const int *indices, unsigned long first, unsigned long last)
+{
+	Vector_clear(&chunk->m_verticesOut);
+	Vector_clear(&chunk->m_indicesOut);
+	Vector_clear(&chunk->m_pendingVertices);
+	VertexProcessor_cacheClear(chunk);
+
+	for (unsigned long i = first; i < last; ++i)
+		VertexProcessor_addIndex(chunk, indices[i]);
+
+	VertexProcessor_shadeVertices(chunk);
+	VertexProcessor_preparePrimitives(chunk, mode);
+}
+
+void VertexProcessor_reserveChunkProcessors(VertexProcessor *vp, int count)
+{
+	while (Vector_size(&vp->m_chunkProcessors) < count)
+	{
+		VertexProcessor *chunk = malloc(sizeof(VertexProcessor));
+		VertexProcessor_construct(chunk, vp->m_rasterizer);
+		chunk->m_parallelFrontEnd = false;
+		Vector_append(&vp->m_chunkProcessors, chunk, VertexProcessor*);
+	}
+
+	for (int i = 0; i < count; ++i)
+		VertexProcessor_copySettings(Vector_element(&vp->m_chunkProcessors, i, VertexProcessor*), vp);
+}
+
+void VertexProcessor_gatherChunkStats(VertexProcessor *vp, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		VertexProcessor *chunk = Vector_element(&vp->m_chunkProcessors, i, VertexProcessor*);
+		vp->m_vertexCacheHits += chunk->m_vertexCacheHits;
+		vp->m_vertexCacheMisses += chunk->m_vertexCacheMisses;
+		VertexProcessor_resetVertexCacheStats(chunk);
+	}
+}
+
+void VertexProcessor_copySettings(VertexProcessor *dst, const VertexProcessor *src)
+{
+	dst->m_viewport = src->m_viewport;
+	dst->m_depthRange = src->m_depthRange;
+	dst->m_guardBand = src->m_guardBand;
+	dst->m_cullMode = src->m_cullMode;
+	dst->m_rasterizer = src->m_rasterizer;
+	dst->m_vertexShader = src->m_vertexShader;
+	dst->m_processVertexFunc = src->m_processVertexFunc;
+	dst->m_processVertexBatchFunc = src->m_processVertexBatchFunc;
+	dst->m_attribCount = src->m_attribCount;
+	memcpy(dst->m_attributes, src->m_attributes, sizeof(src->m_attributes));
+
+	dst->m_vertexCacheMode = src->m_vertexCacheMode;
+	VertexProcessor_setBatchSize(dst, src->m_autoBatchSize ? 0 : src->m_batchSize);
+	VertexProcessor_updateLayout(dst);
+}
+
+void VertexProcessor_addIndex(VertexProcessor *vp, int index)
+{
+	int outputIndex = VertexProcessor_cacheLookup(vp, index);
+
+	if (outputIndex < -1)
+		outputIndex = VertexProcessor_useCarry(vp, index, -2 - outputIndex);
+
+	if (outputIndex != -1)
+	{
+		vp->m_vertexCacheHits++;
+		Vector_append(&vp->m_indicesOut, outputIndex, int);
+		return;
+	}
+
+	vp->m_vertexCacheMisses++;
+
+	outputIndex = Vector_size(&vp->m_verticesOut);
+	Vector_append(&vp->m_indicesOut, outputIndex, int);
+	Vector_set_size(&vp->m_verticesOut, outputIndex + 1);
+
+	// The misses of a batch are shaded together on the job system.
+	Vector_append(&vp->m_pendingVertices, index, int);
+	Vector_append(&vp->m_pendingVertices, outputIndex, int);
+
+	VertexProcessor_cacheSet(vp, index, outputIndex);
+}
+
 int VertexProcessor_clipMask(VertexShaderOutput *v)
 {
 	int mask = 0;
@@ -164,6 +515,21 @@ int VertexProcessor_clipMask(VertexShaderOutput *v)
 	return mask;
 }
 
+int VertexProcessor_clipMaskGuardBand(const VertexProcessor *vp, const VertexShaderOutput *v)
+{
+	float gx = vp->m_guardBand.x * v->w;
+	float gy = vp->m_guardBand.y * v->w;
+
+	int mask = 0;
+	if (gx - v->x < 0) mask |= ClipMask_PosX;
+	if (v->x + gx < 0) mask |= ClipMask_NegX;
+	if (gy - v->y < 0) mask |= ClipMask_PosY;
+	if (v->y + gy < 0) mask |= ClipMask_NegY;
+	if (v->w - v->z < 0) mask |= ClipMask_PosZ;
+	if (v->z + v->w < 0) mask |= ClipMask_NegZ;
+	return mask;
+}
+
 const void *VertexProcessor_attribPointer(VertexProcessor *vp, int attribIndex, int elementIndex)
 {
 	const struct Attribute *attrib = &vp->m_attributes[attribIndex];
@@ -175,24 +541,209 @@ void VertexProcessor_processVertex(VertexProcessor *vp, VertexShaderInput in, Ve
 	(*vp->m_processVertexFunc)(in, out);
 }
 
+int VertexProcessor_cacheLookup(VertexProcessor *vp, int index)
+{
+	if (vp->m_vertexCacheMode == VCM_Full)
+		return VertexHashCache_lookup(&vp->m_vertexHashCache, index);
+	return VertexCache_lookup(&vp->m_vertexCache, index);
+}
+
+void VertexProcessor_cacheSet(VertexProcessor *vp, int index, int outputIndex)
+{
+	if (vp->m_vertexCacheMode == VCM_Full)
+		VertexHashCache_set(&vp->m_vertexHashCache, index, outputIndex);
+	else
+		VertexCache_set(&vp->m_vertexCache, index, outputIndex);
+}
+
+void VertexProcessor_cacheClear(VertexProcessor *vp)
+{
+	if (vp->m_vertexCacheMode == VCM_Full)
+		VertexHashCache_clear(&vp->m_vertexHashCache);
+	else
+		VertexCache_clear(&vp->m_vertexCache);
+}
+
+void VertexProcessor_saveCarry(VertexProcessor *vp, const int *indices, unsigned long end)
+{
+	unsigned long begin = end > VertexCarryWindow ? end - VertexCarryWindow : 0;
+
+	// The window can reach back to vertices carried into this batch but not
+	// used by it. Copy them in before the old carry is replaced.
+	for (unsigned long i = begin; i < end; ++i)
+	{
+		int outputIndex = VertexProcessor_cacheLookup(vp, indices[i]);
+		if (outputIndex < -1)
+			VertexProcessor_useCarry(vp, indices[i], -2 - outputIndex);
+	}
+
+	Vector_clear(&vp->m_carryIndices);
+	Vector_clear(&vp->m_carryVertices);
+
+	for (unsigned long i = begin; i < end; ++i)
+	{
+		int index = indices[i];
+		int outputIndex = VertexProcessor_cacheLookup(vp, index);
+		if (outputIndex == -1)
+			continue;
+
+		// Skip indices already saved.
+		bool found = false;
+		for (int j = 0; j < Vector_size(&vp->m_carryIndices) && !found; ++j)
+			found = Vector_element(&vp->m_carryIndices, j, int) == index;
+		if (found)
+			continue;
+
+		int carryIndex = Vector_size(&vp->m_carryIndices);
+		Vector_append(&vp->m_carryIndices, index, int);
+		Vector_set_size(&vp->m_carryVertices, carryIndex + 1);
+		memcpy(Vector_at(&vp->m_carryVertices, carryIndex), Vector_at(&vp->m_verticesOut, outputIndex), vp->m_verticesOut.elem_size);
+	}
+}
+
+void VertexProcessor_restoreCarry(VertexProcessor *vp)
+{
+	// Only the cache learns about the carried vertices, so the ones the new
+	// batch does not use are never copied, clipped or transformed.
+	int carryCount = Vector_size(&vp->m_carryIndices);
+	for (int i = 0; i < carryCount; ++i)
+	{
+		VertexProcessor_cacheSet(vp, Vector_element(&vp->m_carryIndices, i, int), -2 - i);
+	}
+}
+
+int VertexProcessor_useCarry(VertexProcessor *vp, int index, int carryIndex)
+{
+	int outputIndex = Vector_size(&vp->m_verticesOut);
+	Vector_set_size(&vp->m_verticesOut, outputIndex + 1);
+	memcpy(Vector_at(&vp->m_verticesOut, outputIndex), Vector_at(&vp->m_carryVertices, carryIndex), vp->m_verticesOut.elem_size);
+
+	VertexProcessor_cacheSet(vp, index, outputIndex);
+	return outputIndex;
+}
+
+void VertexProcessor_updateLayout(VertexProcessor *vp)
+{
+	const PixelShader *ps = vp->m_rasterizer->m_pixelShader;
+	vp->m_avarCount = ps ? ps->AVarCount : MaxAVars;
+	vp->m_pvarCount = ps ? ps->PVarCount : MaxPVars;
+	vp->m_pvarOffset = 4 + vp->m_avarCount;
+	vp->m_vertexSize = vp->m_pvarOffset + vp->m_pvarCount;
+
+	int elemSize = vp->m_vertexSize * sizeof(float);
+	if (vp->m_verticesOut.elem_size != elemSize)
+	{
+		Vector_set_elem_size(&vp->m_verticesOut, elemSize);
+		Vector_set_elem_size(&vp->m_carryVertices, elemSize);
+	}
+
+	// The automatic batch size depends on the packed vertex size.
+	if (vp->m_autoBatchSize && VertexProcessor_autoBatchSize(vp) != vp->m_batchSize)
+		VertexProcessor_setBatchSize(vp, 0);
+}
+
+void VertexProcessor_packVertex(VertexProcessor *vp, float *dst, const VertexShaderOutput *src)
+{
+	memcpy(dst, src, (4 + vp->m_avarCount) * sizeof(float));
+	memcpy(dst + vp->m_pvarOffset, src->pvar, vp->m_pvarCount * sizeof(float));
+}
+
 void VertexProcessor_initVertexInput(VertexProcessor *vp, VertexShaderInput in, int index)
 {
 	for (int i = 0; i < vp->m_attribCount; ++i)
 		in[i] = VertexProcessor_attribPointer(vp, i, index);
 }
 
-void VertexProcessor_clipPoints(VertexProcessor *vp)
+void VertexProcessor_shadeVertices(VertexProcessor *vp)
+{
+	int count = Vector_size(&vp->m_pendingVertices) / 2;
+	JobSystem_parallelFor(count, VertexGrain, VertexProcessor_shadeJob, vp);
+	Vector_clear(&vp->m_pendingVertices);
+}
+
+void VertexProcessor_shadeJob(void *data, int begin, int end)
+{
+	VertexProcessor *vp = data;
+	const int *pending = vp->m_pendingVertices.data;
+
+	if (!vp->m_processVertexBatchFunc)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			VertexShaderInput vIn;
+			VertexProcessor_initVertexInput(vp, vIn, pending[2 * i]);
+
+			VertexShaderOutput vOut;
+			VertexProcessor_processVertex(vp, vIn, &vOut);
+			VertexProcessor_packVertex(vp, Vector_at(&vp->m_verticesOut, pending[2 * i + 1]), &vOut);
+		}
+		return;
+	}
+
+	VertexBatch batch;
+	for (int i = 0; i < vp->m_attribCount; ++i)
+	{
+		batch.attrib[i] = vp->m_attributes[i].buffer;
+		batch.stride[i] = vp->m_attributes[i].stride;
+	}
+
+	for (int i = begin; i < end; i += VertexBatchSize)
+	{
+		batch.count = min(end - i, VertexBatchSize);
+		for (int j = 0; j < batch.count; ++j)
+			batch.index[j] = pending[2 * (i + j)];
+
+		(*vp->m_processVertexBatchFunc)(&batch);
+		VertexProcessor_storeVertexBatch(vp, &batch, pending + 2 * i);
+	}
+}
+
+void VertexProcessor_storeVertexBatch(VertexProcessor *vp, const VertexBatch *batch, const int *pending)
+{
+	for (int i = 0; i < batch->count; ++i)
+	{
+		VertexShaderOutput *vOut = Vector_at(&vp->m_verticesOut, pending[2 * i + 1]);
+		vOut->x = batch->x[i];
+		vOut->y = batch->y[i];
+		vOut->z = batch->z[i];
+		vOut->w = batch->w[i];
+		for (int j = 0; j < vp->m_avarCount; ++j)
+			vOut->avar[j] = batch->avar[j][i];
+
+		float *pvar = (float*)vOut + vp->m_pvarOffset;
+		for (int j = 0; j < vp->m_pvarCount; ++j)
+			pvar[j] = batch->pvar[j][i];
+	}
+}
+
+void VertexProcessor_computeClipMasks(VertexProcessor *vp, bool guardBand)
+{
+    Vector_clear(&vp->m_clipMask);
+    Vector_set_size(&vp->m_clipMask, Vector_size(&vp->m_verticesOut));
+
+    ClipMaskJob job = { vp, guardBand };
+    JobSystem_parallelFor(Vector_size(&vp->m_verticesOut), VertexGrain, VertexProcessor_clipMaskJob, &job);
+}
+
+void VertexProcessor_clipMaskJob(void *data, int begin, int end)
 {
-	Vector_clear(&vp->m_clipMask);
+    const ClipMaskJob *job = data;
+    VertexProcessor *vp = job->vp;
 
-    int verticesSize = Vector_size(&vp->m_verticesOut);
-    Vector_set_size(&vp->m_clipMask, verticesSize);
-	
-    for (unsigned long i = 0; i < verticesSize; i++)
+    // The viewport outcodes are kept in the upper bits for trivial rejection.
+    for (int i = begin; i < end; i++)
     {
-        VertexShaderOutput *v = &Vector_element(&vp->m_verticesOut, i, VertexShaderOutput);
-        Vector_element(&vp->m_clipMask, i, int) = VertexProcessor_clipMask(v);
+        VertexShaderOutput *v = Vector_at(&vp->m_verticesOut, i);
+        int mask = VertexProcessor_clipMask(v);
+        if (job->guardBand)
+            mask = VertexProcessor_clipMaskGuardBand(vp, v) | (mask << ClipMask_RejectShift);
+        Vector_element(&vp->m_clipMask, i, int) = mask;
     }
+}
+
+void VertexProcessor_clipPoints(VertexProcessor *vp)
+{
+    VertexProcessor_computeClipMasks(vp, false);
 
     int indicesSize = Vector_size(&vp->m_indicesOut);
 	for (unsigned long i = 0; i < indicesSize; i++)
@@ -206,16 +757,7 @@ void VertexProcessor_clipPoints(VertexProcessor *vp)
 
 void VertexProcessor_clipLines(VertexProcessor *vp)
 {
-    Vector_clear(&vp->m_clipMask);
-	
-    int verticesSize = Vector_size(&vp->m_verticesOut);
-    Vector_set_size(&vp->m_clipMask, verticesSize);
-
-    for (unsigned long i = 0; i < verticesSize; i++)
-    {
-        VertexShaderOutput *v = &Vector_element(&vp->m_verticesOut, i, VertexShaderOutput);
-        Vector_element(&vp->m_clipMask, i, int) = VertexProcessor_clipMask(v);
-    }
+    VertexProcessor_computeClipMasks(vp, false);
 
     int indicesSize = Vector_size(&vp->m_indicesOut);
 	for (unsigned long i = 0; i < indicesSize; i += 2)
@@ -223,13 +765,24 @@ void VertexProcessor_clipLines(VertexProcessor *vp)
 		int index0 = Vector_element(&vp->m_indicesOut, i, int);
 		int index1 = Vector_element(&vp->m_indicesOut, i + 1, int);
 
-		VertexShaderOutput v0 = Vector_element(&vp->m_verticesOut, index0, VertexShaderOutput);
-		VertexShaderOutput v1 = Vector_element(&vp->m_verticesOut, index1, VertexShaderOutput);
-
         int mask0 = Vector_element(&vp->m_clipMask, index0, int);
         int mask1 = Vector_element(&vp->m_clipMask, index1, int);
 
+		if (mask0 & mask1)
+		{
+			Vector_element(&vp->m_indicesOut, i, int) = -1;
+            Vector_element(&vp->m_indicesOut, i + 1, int) = -1;
+			continue;
+		}
+
 		int clipMask = mask0 | mask1;
+		if (!clipMask)
+			continue;
+
+		// Copies since the vector may grow below.
+		VertexShaderOutput v0, v1;
+		memcpy(&v0, Vector_at(&vp->m_verticesOut, index0), vp->m_verticesOut.elem_size);
+		memcpy(&v1, Vector_at(&vp->m_verticesOut, index1), vp->m_verticesOut.elem_size);
 
         LineClipper lineClipper;
         LineClipper_construct(&lineClipper, &v0, &v1);
@@ -250,37 +803,86 @@ void VertexProcessor_clipLines(VertexProcessor *vp)
 
 		if (mask0)
 		{
-			VertexShaderOutput newV = interpolateVertex(&v0, &v1, lineClipper.t0, vp->m_attribCount);
-			Vector_append(&vp->m_verticesOut, newV, VertexShaderOutput);
-			Vector_element(&vp->m_indicesOut, i, int) = Vector_size(&vp->m_verticesOut) - 1;
+			int newIndex = Vector_size(&vp->m_verticesOut);
+			Vector_set_size(&vp->m_verticesOut, newIndex + 1);
+			interpolateVertex(Vector_at(&vp->m_verticesOut, newIndex), (float*)&v0, (float*)&v1, lineClipper.t0, vp->m_vertexSize);
+			Vector_element(&vp->m_indicesOut, i, int) = newIndex;
 		}
 
 		if (mask1)
 		{
-			VertexShaderOutput newV = interpolateVertex(&v0, &v1, lineClipper.t1, vp->m_attribCount);
-            Vector_append(&vp->m_verticesOut, newV, VertexShaderOutput);
-            Vector_element(&vp->m_indicesOut, i + 1, int) = Vector_size(&vp->m_verticesOut) - 1;
+			int newIndex = Vector_size(&vp->m_verticesOut);
+			Vector_set_size(&vp->m_verticesOut, newIndex + 1);
+			interpolateVertex(Vector_at(&vp->m_verticesOut, newIndex), (float*)&v0, (float*)&v1, lineClipper.t1, vp->m_vertexSize);
+            Vector_element(&vp->m_indicesOut, i + 1, int) = newIndex;
+		}
+	}
+}
+
+bool VertexProcessor_cullHomogeneous(VertexProcessor *vp, int i0, int i1, int i2)
+{
+	const VertexShaderOutput *v0 = Vector_at(&vp->m_verticesOut, i0);
+	const VertexShaderOutput *v1 = Vector_at(&vp->m_verticesOut, i1);
+	const VertexShaderOutput *v2 = Vector_at(&vp->m_verticesOut, i2);
+
+	// The sign of det(x, y, w) is the sign of the screen space area and stays
+	// valid for vertices behind the eye.
+	float det = v0->x * (v1->y * v2->w - v2->y * v1->w)
+		- v0->y * (v1->x * v2->w - v2->x * v1->w)
+		+ v0->w * (v1->x * v2->y - v2->x * v1->y);
+
+	// Triangles seen edge-on cover no pixels. They are kept when culling is
+	// disabled so CM_None passes every triangle on to the rasterizer.
+	if (det == 0.0f)
+		return vp->m_cullMode != CM_None;
+
+	return (det < 0 && vp->m_cullMode == CM_CW) || (det > 0 && vp->m_cullMode == CM_CCW);
+}
+
+void VertexProcessor_rejectJob(void *data, int begin, int end)
+{
+	VertexProcessor *vp = data;
+
+	for (int t = begin; t < end; ++t)
+	{
+		int i = t * 3;
+		int i0 = Vector_element(&vp->m_indicesOut, i, int);
+		int i1 = Vector_element(&vp->m_indicesOut, i + 1, int);
+		int i2 = Vector_element(&vp->m_indicesOut, i + 2, int);
+
+        int mask0 = Vector_element(&vp->m_clipMask, i0, int);
+        int mask1 = Vector_element(&vp->m_clipMask, i1, int);
+        int mask2 = Vector_element(&vp->m_clipMask, i2, int);
+
+		// Reject triangles with all vertices outside the same plane and
+		// backfacing triangles before any clipping work is done.
+		if ((mask0 & mask1 & mask2) || VertexProcessor_cullHomogeneous(vp, i0, i1, i2))
+		{
+			Vector_element(&vp->m_indicesOut, i, int) = -1;
+            Vector_element(&vp->m_indicesOut, i + 1, int) = -1;
+            Vector_element(&vp->m_indicesOut, i + 2, int) = -1;
 		}
 	}
 }
 
 void VertexProcessor_clipTriangles(VertexProcessor *vp)
 {
-    Vector_clear(&vp->m_clipMask);
-    int verticesSize = Vector_size(&vp->m_verticesOut);
-	Vector_set_size(&vp->m_clipMask, verticesSize);
+    // With a guard band the x and y planes are moved out to its edges.
+    float gx = vp->m_guardBand.x;
+    float gy = vp->m_guardBand.y;
 
-    for (unsigned long i = 0; i < verticesSize; i++)
-    {
-        VertexShaderOutput *v = &Vector_element(&vp->m_verticesOut, i, VertexShaderOutput);
-        Vector_element(&vp->m_clipMask, i, int) = VertexProcessor_clipMask(v);
-    }
+    VertexProcessor_computeClipMasks(vp, VertexProcessor_guardBandEnabled(vp));
 
 	unsigned long n = Vector_size(&vp->m_indicesOut);
+	JobSystem_parallelFor(n / 3, TriangleGrain, VertexProcessor_rejectJob, vp);
 
+	// Clipping appends vertices and triangles so it stays on this thread.
 	for (unsigned long i = 0; i < n; i += 3)
 	{
 		int i0 = Vector_element(&vp->m_indicesOut, i, int);
+		if (i0 == -1)
+			continue;
+
 		int i1 = Vector_element(&vp->m_indicesOut, i + 1, int);
 		int i2 = Vector_element(&vp->m_indicesOut, i + 2, int);
 
@@ -288,14 +890,16 @@ void VertexProcessor_clipTriangles(VertexProcessor *vp)
         int mask1 = Vector_element(&vp->m_clipMask, i1, int);
         int mask2 = Vector_element(&vp->m_clipMask, i2, int);
 
-		int clipMask = mask0 | mask1 | mask2;
+		int clipMask = (mask0 | mask1 | mask2) & ClipMask_All;
+		if (!clipMask)
+			continue;
 
-        PolyClipper_init(&vp->m_polyClipper, &vp->m_verticesOut, i0, i1, i2, vp->m_attribCount);
+        PolyClipper_init(&vp->m_polyClipper, &vp->m_verticesOut, i0, i1, i2, vp->m_vertexSize);
 
-		if (clipMask & ClipMask_PosX) PolyClipper_clipToPlane(&vp->m_polyClipper, -1, 0, 0, 1);
-		if (clipMask & ClipMask_NegX) PolyClipper_clipToPlane(&vp->m_polyClipper, 1, 0, 0, 1);
-		if (clipMask & ClipMask_PosY) PolyClipper_clipToPlane(&vp->m_polyClipper, 0, -1, 0, 1);
-		if (clipMask & ClipMask_NegY) PolyClipper_clipToPlane(&vp->m_polyClipper, 0, 1, 0, 1);
+		if (clipMask & ClipMask_PosX) PolyClipper_clipToPlane(&vp->m_polyClipper, -1, 0, 0, gx);
+		if (clipMask & ClipMask_NegX) PolyClipper_clipToPlane(&vp->m_polyClipper, 1, 0, 0, gx);
+		if (clipMask & ClipMask_PosY) PolyClipper_clipToPlane(&vp->m_polyClipper, 0, -1, 0, gy);
+		if (clipMask & ClipMask_NegY) PolyClipper_clipToPlane(&vp->m_polyClipper, 0, 1, 0, gy);
 		if (clipMask & ClipMask_PosZ) PolyClipper_clipToPlane(&vp->m_polyClipper, 0, 0,-1, 1);
 		if (clipMask & ClipMask_NegZ) PolyClipper_clipToPlane(&vp->m_polyClipper, 0, 0, 1, 1);
 
@@ -341,33 +945,46 @@ void VertexProcessor_clipPrimitives(VertexProcessor *vp, DrawMode mode)
 }
 
 void VertexProcessor_processPrimitives(VertexProcessor *vp, DrawMode mode)
+{
+	VertexProcessor_preparePrimitives(vp, mode);
+    VertexProcessor_drawPrimitives(vp, mode);
+}
+
+void VertexProcessor_preparePrimitives(VertexProcessor *vp, DrawMode mode)
 {
 	VertexProcessor_clipPrimitives(vp, mode);
     VertexProcessor_transformVertices(vp);
-    VertexProcessor_drawPrimitives(vp, mode);
+
+	if (mode == DM_Triangle)
+		VertexProcessor_cullTriangles(vp);
 }
 
-int VertexProcessor_primitiveCount(VertexProcessor *vp, DrawMode mode)
+int VertexProcessor_verticesPerPrimitive(DrawMode mode)
 {
-	int factor;
-	
 	switch (mode)
 	{
-		case DM_Point: factor = 1; break;
-		case DM_Line: factor = 2; break;
-		case DM_Triangle: factor = 3; break;
+		case DM_Point: return 1;
+		case DM_Line: return 2;
+		default: return 3;
 	}
+}
 
-	return Vector_size(&vp->m_indicesOut) / factor;
+int VertexProcessor_primitiveCount(VertexProcessor *vp, DrawMode mode)
+{
+	return Vector_size(&vp->m_indicesOut) / VertexProcessor_verticesPerPrimitive(mode);
 }
 
 void VertexProcessor_drawPrimitives(VertexProcessor *vp, DrawMode mode)
 {
+	Rasterizer_setVertexLayout(vp->m_rasterizer, vp->m_verticesOut.elem_size, vp->m_pvarOffset);
+
 	switch (mode)
 	{
 		case DM_Triangle:
-            VertexProcessor_cullTriangles(vp);
-			Rasterizer_drawTriangleList(vp->m_rasterizer, vp->m_verticesOut.data, vp->m_indicesOut.data, Vector_size(&vp->m_indicesOut));
+			if (VertexProcessor_guardBandEnabled(vp))
+				VertexProcessor_drawTrianglesGuardBand(vp);
+			else
+				Rasterizer_drawTriangleList(vp->m_rasterizer, vp->m_verticesOut.data, vp->m_indicesOut.data, Vector_size(&vp->m_indicesOut));
 			break;
 		case DM_Line:
             Rasterizer_drawLineList(vp->m_rasterizer, vp->m_verticesOut.data, vp->m_indicesOut.data, Vector_size(&vp->m_indicesOut));
@@ -376,12 +993,38 @@ void VertexProcessor_drawPrimitives(VertexProcessor *vp, DrawMode mode)
             Rasterizer_drawPointList(vp->m_rasterizer, vp->m_verticesOut.data, vp->m_indicesOut.data, Vector_size(&vp->m_indicesOut));
 			break;
 	}
+
+	Rasterizer_setDefaultVertexLayout(vp->m_rasterizer);
+}
+
+void VertexProcessor_drawTrianglesGuardBand(VertexProcessor *vp)
+{
+	Rasterizer *rs = vp->m_rasterizer;
+	int minX = rs->m_minX, minY = rs->m_minY;
+	int maxX = rs->m_maxX, maxY = rs->m_maxY;
+
+	// Triangles may extend past the viewport, so let the scissor rect cut them.
+	int x0 = max(minX, vp->m_viewport.x);
+	int y0 = max(minY, vp->m_viewport.y);
+	int x1 = min(maxX, vp->m_viewport.x + vp->m_viewport.width);
+	int y1 = min(maxY, vp->m_viewport.y + vp->m_viewport.height);
+	Rasterizer_setScissorRect(rs, x0, y0, max(x1 - x0, 0), max(y1 - y0, 0));
+
+	Rasterizer_drawTriangleList(rs, vp->m_verticesOut.data, vp->m_indicesOut.data, Vector_size(&vp->m_indicesOut));
+
+	Rasterizer_setScissorRect(rs, minX, minY, maxX - minX, maxY - minY);
 }
 
 void VertexProcessor_cullTriangles(VertexProcessor *vp)
 {
-    int indicesSize = Vector_size(&vp->m_indicesOut);
-	for (unsigned long i = 0; i + 3 <= indicesSize; i += 3)
+    JobSystem_parallelFor(Vector_size(&vp->m_indicesOut) / 3, TriangleGrain, VertexProcessor_cullJob, vp);
+}
+
+void VertexProcessor_cullJob(void *data, int begin, int end)
+{
+    VertexProcessor *vp = data;
+
+	for (int i = begin * 3; i < end * 3; i += 3)
 	{
         int idx0 = Vector_element(&vp->m_indicesOut, i, int);
 
@@ -391,9 +1034,9 @@ void VertexProcessor_cullTriangles(VertexProcessor *vp)
         int idx1 = Vector_element(&vp->m_indicesOut, i + 1, int);
         int idx2 = Vector_element(&vp->m_indicesOut, i + 2, int);
 
-		VertexShaderOutput *v0 = &Vector_element(&vp->m_verticesOut, idx0, VertexShaderOutput);
-		VertexShaderOutput *v1 = &Vector_element(&vp->m_verticesOut, idx1, VertexShaderOutput);
-        VertexShaderOutput *v2 = &Vector_element(&vp->m_verticesOut, idx2, VertexShaderOutput);
+		VertexShaderOutput *v0 = Vector_at(&vp->m_verticesOut, idx0);
+		VertexShaderOutput *v1 = Vector_at(&vp->m_verticesOut, idx1);
+        VertexShaderOutput *v2 = Vector_at(&vp->m_verticesOut, idx2);
 
 		float facing = (v0->x - v1->x) * (v2->y - v1->y) - (v2->x - v1->x) * (v0->y - v1->y);
 
@@ -426,18 +1069,28 @@ void VertexProcessor_transformVertices(VertexProcessor *vp)
 	Vector_clear(&vp->m_alreadyProcessed);
     Vector_set_size(&vp->m_alreadyProcessed, Vector_size(&vp->m_verticesOut));
 
+    // Mark the vertices still referenced after clipping.
     int indicesSize = Vector_size(&vp->m_indicesOut);
 	for (unsigned long i = 0; i < indicesSize; i++)
 	{
 		int index = Vector_element(&vp->m_indicesOut, i, int);
+		if (index != -1)
+			Vector_element(&vp->m_alreadyProcessed, index, bool) = true;
+	}
 
-		if (index == -1)
-			continue;
+	JobSystem_parallelFor(Vector_size(&vp->m_verticesOut), VertexGrain, VertexProcessor_transformJob, vp);
+}
 
-		if (Vector_element(&vp->m_alreadyProcessed, index, bool))
+void VertexProcessor_transformJob(void *data, int begin, int end)
+{
+	VertexProcessor *vp = data;
+
+	for (int index = begin; index < end; index++)
+	{
+		if (!Vector_element(&vp->m_alreadyProcessed, index, bool))
 			continue;
 
-        VertexShaderOutput *vOut = &Vector_element(&vp->m_verticesOut, index, VertexShaderOutput);
+        VertexShaderOutput *vOut = Vector_at(&vp->m_verticesOut, index);
 
 		// Perspective divide
 		float invW = 1.0f / vOut->w;
@@ -449,7 +1102,5 @@ void VertexProcessor_transformVertices(VertexProcessor *vp)
 		vOut->x = (vp->m_viewport.px * vOut->x + vp->m_viewport.ox);
 		vOut->y = (vp->m_viewport.py * -vOut->y + vp->m_viewport.oy);
 		vOut->z = 0.5f * (vp->m_depthRange.f - vp->m_depthRange.n) * vOut->z + 0.5f * (vp->m_depthRange.n + vp->m_depthRange.f);
-
-		Vector_element(&vp->m_alreadyProcessed, index, bool) = true;
 	}
 }
@@ -35,13 +35,29 @@ SOFTWARE.
 #include "VertexCache.h"
 #include "Vector.h"
 
+enum {
+    /// Primitives per batch used until VertexProcessor_setBatchSize is called.
+    DefaultBatchSize = 1024,
+    /// Limits of the automatically chosen batch size.
+    MinAutoBatchSize = 128,
+    MaxAutoBatchSize = 4096,
+    /// Number of trailing indices of a batch whose vertices are kept for the next one.
+    VertexCarryWindow = 64,
+    /// Largest screen coordinate a guard band may reach. Keeps the fixed point
+    /// edge equations of unclipped triangles within 32 bits.
+    MaxGuardBandCoord = 1 << 16
+};
+
 enum {
     ClipMask_PosX = 0x01,
     ClipMask_NegX = 0x02,
     ClipMask_PosY = 0x04,
     ClipMask_NegY = 0x08,
     ClipMask_PosZ = 0x10,
-    ClipMask_NegZ = 0x20
+    ClipMask_NegZ = 0x20,
+    ClipMask_All = 0x3f,
+    /// Shift of the viewport outcodes stored next to the guard band outcodes.
+    ClipMask_RejectShift = 8
 };
 
 /// Process vertices and pass them to a rasterizer.
@@ -56,12 +72,19 @@ typedef struct VertexProcessor_s {
 		float n, f;
 	} m_depthRange;
 
+	// The guard band in use is the requested one limited to MaxGuardBandCoord.
+	struct {
+		float x, y;
+		float requestX, requestY;
+	} m_guardBand;
+
 	CullMode m_cullMode;
 	Rasterizer *m_rasterizer;
 
     VertexShader *m_vertexShader;
 	
 	void (*m_processVertexFunc)(VertexShaderInput, VertexShaderOutput*);
+	void (*m_processVertexBatchFunc)(VertexBatch*);
 	int m_attribCount;
 
 	struct Attribute {
@@ -69,9 +92,38 @@ typedef struct VertexProcessor_s {
 		int stride;
 	} m_attributes[MaxVertexAttribs];
 
+	VertexCacheMode m_vertexCacheMode;
+	VertexCache m_vertexCache;
+	VertexHashCache m_vertexHashCache;
+	unsigned long m_vertexCacheHits;
+	unsigned long m_vertexCacheMisses;
+
+	int m_batchSize;
+	bool m_autoBatchSize;
+
+	// Packed layout of m_verticesOut: x, y, z, w, the affine and then the
+	// perspective variables used by the pixel shader. Sizes are in floats.
+	int m_avarCount;
+	int m_pvarCount;
+	int m_pvarOffset;
+	int m_vertexSize;
+
+	// Untransformed vertices carried over to the next batch.
+	Vector m_carryIndices;
+	Vector m_carryVertices;
+
 	// Some temporary variables for speed
 	PolyClipper m_polyClipper;
 
+	// Processors for the chunks of the parallel front end.
+	bool m_parallelFrontEnd;
+	bool m_streaming;
+	Vector m_chunkProcessors;
+	Vector m_streamSlots;
+
+	// Cache misses waiting for the vertex shader as pairs of input index and output slot.
+	Vector m_pendingVertices;
+
 	//std::vector<VertexShaderOutput> m_verticesOut;
     Vector m_verticesOut;
 
@@ -102,6 +154,12 @@ void VertexProcessor_setViewport(VertexProcessor *vp, int x, int y, int width, i
 /** Default is (0, 1) */
 void VertexProcessor_setDepthRange(VertexProcessor *vp, float n, float f);
 
+/// Set the guard band as a multiple of the viewport size. Values <= 1 turn it off.
+void VertexProcessor_setGuardBand(VertexProcessor *vp, float x, float y);
+bool VertexProcessor_guardBandEnabled(const VertexProcessor *vp);
+/// Limit the requested guard band so it stays within MaxGuardBandCoord for the viewport.
+void VertexProcessor_updateGuardBand(VertexProcessor *vp);
+
 /// Set the cull mode.
 /** Default is CullMode::CW to cull clockwise triangles. */
 void VertexProcessor_setCullMode(VertexProcessor *vp, CullMode mode);
@@ -109,25 +167,98 @@ void VertexProcessor_setCullMode(VertexProcessor *vp, CullMode mode);
 /// Set the vertex shader.
 void VertexProcessor_setVertexShader(VertexProcessor *vp, VertexShader *vs);
 
+/// Set the vertex cache mode.
+/** Default is VCM_DirectMapped. */
+void VertexProcessor_setVertexCacheMode(VertexProcessor *vp, VertexCacheMode mode);
+/// Set the number of primitives processed per batch. 0 picks a size that fits the L2 cache.
+void VertexProcessor_setBatchSize(VertexProcessor *vp, int primitives);
+int VertexProcessor_batchSize(const VertexProcessor *vp);
+/// Batch size that keeps a batch of packed vertices within half of the L2 cache.
+int VertexProcessor_autoBatchSize(const VertexProcessor *vp);
+void VertexProcessor_vertexCacheStats(const VertexProcessor *vp, unsigned long *hits, unsigned long *misses);
+void VertexProcessor_resetVertexCacheStats(VertexProcessor *vp);
+
+/// Split large draws into chunks that are shaded, clipped and culled in parallel.
+/** The chunks are rasterized in submission order. Default is true. */
+void VertexProcessor_setParallelFrontEnd(VertexProcessor *vp, bool enable);
+
+/// Overlap the front end of later chunks with the rasterization of earlier ones.
+/** Only used together with the parallel front end. Default is false. */
+void VertexProcessor_setStreaming(VertexProcessor *vp, bool enable);
+
 /// Set a vertex attrib pointer.
 void VertexProcessor_setVertexAttribPointer(VertexProcessor *vp, int index, int stride, const void *buffer);
 
 /// Draw a number of points, lines or triangles.
 void VertexProcessor_drawElements(VertexProcessor *vp, DrawMode mode, unsigned long count, int *indices);
 
+struct StreamSlot;
+
+void VertexProcessor_drawElementsParallel(VertexProcessor *vp, DrawMode mode, unsigned long count, const int *indices);
+void VertexProcessor_frontEndJob(void *data, int begin, int end);
+void VertexProcessor_drawElementsStreaming(VertexProcessor *vp, DrawMode mode, unsigned long count, const int *indices);
+void VertexProcessor_submitChunk(struct StreamSlot *slot, unsigned long first, unsigned long last);
+void VertexProcessor_streamJob(void *data, int begin, int end);
+/// Run the front end for indices [first, last) up to rasterization.
+void VertexProcessor_processChunk(VertexProcessor *chunk, DrawMode mode, const int *indices, unsigned long first, unsigned long last);
+/// Make sure there are count chunk processors with the current settings.
+void VertexProcessor_reserveChunkProcessors(VertexProcessor *vp, int count);
+/// Move the vertex cache counters of the first count chunk processors to vp.
+void VertexProcessor_gatherChunkStats(VertexProcessor *vp, int count);
+/// Copy the render state used by the front end.
+void VertexProcessor_copySettings(VertexProcessor *dst, const VertexProcessor *src);
+/// Append an index to the batch, looking it up in the vertex cache first.
+void VertexProcessor_addIndex(VertexProcessor *vp, int index);
+
 int VertexProcessor_clipMask(VertexShaderOutput *v);
+/// Like VertexProcessor_clipMask but tests x and y against the guard band.
+int VertexProcessor_clipMaskGuardBand(const VertexProcessor *vp, const VertexShaderOutput *v);
 const void *VertexProcessor_attribPointer(VertexProcessor *vp, int attribIndex, int elementIndex);
 void VertexProcessor_processVertex(VertexProcessor *vp, VertexShaderInput in, VertexShaderOutput *out);
+int VertexProcessor_cacheLookup(VertexProcessor *vp, int index);
+void VertexProcessor_cacheSet(VertexProcessor *vp, int index, int outputIndex);
+void VertexProcessor_cacheClear(VertexProcessor *vp);
+/// Remember the cached vertices of the last VertexCarryWindow indices before [0, end).
+void VertexProcessor_saveCarry(VertexProcessor *vp, const int *indices, unsigned long end);
+/// Put the remembered vertices into the cache of the new batch.
+/** The cache maps their indices to -2 - carryIndex until they are used. */
+void VertexProcessor_restoreCarry(VertexProcessor *vp);
+/// Copy a remembered vertex into the batch and return its output index.
+int VertexProcessor_useCarry(VertexProcessor *vp, int index, int carryIndex);
+/// Derive the packed vertex layout from the pixel shader of the rasterizer.
+void VertexProcessor_updateLayout(VertexProcessor *vp);
+/// Copy the varyings used by the pixel shader to a packed vertex.
+void VertexProcessor_packVertex(VertexProcessor *vp, float *dst, const VertexShaderOutput *src);
 void VertexProcessor_initVertexInput(VertexProcessor *vp, VertexShaderInput in, int index);
+/// Run the vertex shader on the pending vertices on the job system.
+void VertexProcessor_shadeVertices(VertexProcessor *vp);
+void VertexProcessor_shadeJob(void *data, int begin, int end);
+/// Store the results of the batch vertex shader to the output slots in pending.
+void VertexProcessor_storeVertexBatch(VertexProcessor *vp, const VertexBatch *batch, const int *pending);
+/// Compute the clip mask of every vertex.
+/** With guardBand the low bits test against the guard band and the viewport
+  outcodes are stored above ClipMask_RejectShift. */
+void VertexProcessor_computeClipMasks(VertexProcessor *vp, bool guardBand);
+void VertexProcessor_clipMaskJob(void *data, int begin, int end);
 
 void VertexProcessor_clipPoints(VertexProcessor *vp);
 void VertexProcessor_clipLines(VertexProcessor *vp);
+/// Returns true if the triangle is culled by its facing in homogeneous space.
+bool VertexProcessor_cullHomogeneous(VertexProcessor *vp, int i0, int i1, int i2);
+void VertexProcessor_rejectJob(void *data, int begin, int end);
 void VertexProcessor_clipTriangles(VertexProcessor *vp);
 
 void VertexProcessor_clipPrimitives(VertexProcessor *vp, DrawMode mode);
 void VertexProcessor_processPrimitives(VertexProcessor *vp, DrawMode mode);
+/// Clip, transform and cull the primitives of the batch.
+void VertexProcessor_preparePrimitives(VertexProcessor *vp, DrawMode mode);
+int VertexProcessor_verticesPerPrimitive(DrawMode mode);
 int VertexProcessor_primitiveCount(VertexProcessor *vp, DrawMode mode);
 
 void VertexProcessor_drawPrimitives(VertexProcessor *vp, DrawMode mode);
 void VertexProcessor_cullTriangles(VertexProcessor *vp);
+void VertexProcessor_cullJob(void *data, int begin, int end);
+/// Draw the triangles with the scissor rect narrowed to the viewport.
+void VertexProcessor_drawTrianglesGuardBand(VertexProcessor *vp);
 void VertexProcessor_transformVertices(VertexProcessor *vp);
+void VertexProcessor_transformJob(void *data, int begin, int end);
@@ -28,4 +28,9 @@ void VertexShader_init(VertexShader *vs, int attribCount, ProcessVertexCallback
 {
     vs->AttribCount = attribCount;
     vs->processVertex = callback;
-}
\ No newline at end of file
+}
+
+void VertexShader_setProcessVertexBatch(VertexShader *vs, ProcessVertexBatchCallback callback)
+{
+    vs->processVertexBatch = callback;
+}
@@ -36,8 +36,12 @@ typedef struct VertexShader_s {
 
     /// This performs the vertex processing and will be called for each vertex.
     ProcessVertexCallback processVertex;
+
+    /// Optional batch version of processVertex called for up to VertexBatchSize vertices.
+    ProcessVertexBatchCallback processVertexBatch;
 } VertexShader;
 
-static const VertexShader VertexShader_default = { 0, 0/*NULL*/ };
+static const VertexShader VertexShader_default = { 0, 0/*NULL*/, 0/*NULL*/ };
 
-void VertexShader_init(VertexShader *ps, int attribCount, ProcessVertexCallback callback);
\ No newline at end of file
+void VertexShader_init(VertexShader *ps, int attribCount, ProcessVertexCallback callback);
+void VertexShader_setProcessVertexBatch(VertexShader *vs, ProcessVertexBatchCallback callback);
\ No newline at end of file
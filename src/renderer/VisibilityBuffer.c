@@ -0,0 +1,102 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "VisibilityBuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void VisibilityBuffer_construct(VisibilityBuffer *vb)
+{
+    vb->m_width = 0;
+    vb->m_height = 0;
+    vb->m_blocksX = 0;
+    vb->m_blocksY = 0;
+    vb->m_ids = 0;
+}
+
+void VisibilityBuffer_destruct(VisibilityBuffer *vb)
+{
+    free(vb->m_ids);
+    VisibilityBuffer_construct(vb);
+}
+
+void VisibilityBuffer_reserve(VisibilityBuffer *vb, int width, int height)
+{
+    if (width <= vb->m_width && height <= vb->m_height)
+        return;
+
+    if (width < vb->m_width) width = vb->m_width;
+    if (height < vb->m_height) height = vb->m_height;
+
+    VisibilityBuffer old = *vb;
+
+    vb->m_width = width;
+    vb->m_height = height;
+    vb->m_blocksX = (width + BlockSize - 1) / BlockSize;
+    vb->m_blocksY = (height + BlockSize - 1) / BlockSize;
+
+    vb->m_ids = malloc(sizeof(uint32_t) * vb->m_blocksX * vb->m_blocksY * BlockSize * BlockSize);
+
+    VisibilityBuffer_clear(vb);
+
+    // The scissor rect may grow in the middle of a frame, so keep the ids
+    // recorded so far.
+    for (int by = 0; by < old.m_blocksY; ++by)
+        for (int bx = 0; bx < old.m_blocksX; ++bx)
+            memcpy(VisibilityBuffer_block(vb, bx * BlockSize, by * BlockSize), VisibilityBuffer_block(&old, bx * BlockSize, by * BlockSize),
+                sizeof(uint32_t) * BlockSize * BlockSize);
+
+    free(old.m_ids);
+}
+
+void VisibilityBuffer_clear(VisibilityBuffer *vb)
+{
+    int count = vb->m_blocksX * vb->m_blocksY * BlockSize * BlockSize;
+
+    for (int i = 0; i < count; ++i)
+        vb->m_ids[i] = VisibilityEmpty;
+}
+
+void VisibilityBuffer_writeBlock(VisibilityBuffer *vb, int x, int y, uint64_t mask, uint32_t id)
+{
+    uint32_t *ids = VisibilityBuffer_block(vb, x, y);
+
+    for (int i = 0; mask; ++i, mask >>= 1)
+        if (mask & 1)
+            ids[i] = id;
+}
+
+void VisibilityBuffer_writeSpan(VisibilityBuffer *vb, int x, int y, int count, uint64_t mask, uint32_t id)
+{
+    for (int i = 0; i < count && mask; ++i, mask >>= 1)
+    {
+        if (!(mask & 1))
+            continue;
+
+        int xx = x + i;
+        VisibilityBuffer_block(vb, xx, y)[(y % BlockSize) * BlockSize + xx % BlockSize] = id;
+    }
+}
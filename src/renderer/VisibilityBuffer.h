@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/** @file */
+
+#include "Renderer.h"
+
+#include <stdint.h>
+
+/// Id of pixels without a triangle.
+#define VisibilityEmpty 0xffffffffu
+
+/// Triangle id per pixel stored in BlockSize x BlockSize blocks.
+/** Uses the same layout as DepthBuffer. Written by the first pass of the
+  visibility buffer mode and consumed by Rasterizer_resolveVisibility. */
+typedef struct {
+	int m_width;
+	int m_height;
+	int m_blocksX;
+	int m_blocksY;
+
+	uint32_t *m_ids;
+} VisibilityBuffer;
+
+void VisibilityBuffer_construct(VisibilityBuffer *vb);
+void VisibilityBuffer_destruct(VisibilityBuffer *vb);
+
+/// Make sure the buffer covers [0, width) x [0, height). Growing keeps the ids.
+void VisibilityBuffer_reserve(VisibilityBuffer *vb, int width, int height);
+
+/// Set all pixels to VisibilityEmpty.
+void VisibilityBuffer_clear(VisibilityBuffer *vb);
+
+/// Store id in the pixels of mask in the block at (x, y).
+void VisibilityBuffer_writeBlock(VisibilityBuffer *vb, int x, int y, uint64_t mask, uint32_t id);
+
+/// Store id in the pixels of mask in a span of count <= 64 pixels starting at (x, y).
+void VisibilityBuffer_writeSpan(VisibilityBuffer *vb, int x, int y, int count, uint64_t mask, uint32_t id);
+
+static inline uint32_t *VisibilityBuffer_block(const VisibilityBuffer *vb, int x, int y)
+{
+    return vb->m_ids + ((y / BlockSize) * vb->m_blocksX + x / BlockSize) * BlockSize * BlockSize;
+}
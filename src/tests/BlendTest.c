@@ -0,0 +1,226 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Blends a triangle over a pattern in every blend mode and compares the
+// result with a scalar evaluation of the blend equations. Whole groups of
+// four lanes take the SSE2 path where available, the rest of a span the
+// scalar one, so both have to give exactly the same bytes.
+
+#include "Renderer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { Width = 37, Height = 29 };
+
+static uint8_t g_hits[Height][Width];
+
+// Source values run a bit outside [0, 1] to exercise the clamping.
+static float sourceValue(int x, int y, int c)
+{
+    return ((x * 7 + y * 13 + c * 31) % 71) / 50.0f - 0.2f;
+}
+
+static void shadeBackground(PixelBatch *batch)
+{
+    for (int i = 0; i < batch->count; ++i)
+        for (int c = 0; c < 4; ++c)
+            batch->color[c][i] = ((batch->x[i] * 5 + batch->y[i] * 3 + c * 11) % 17) / 16.0f;
+}
+
+static void shadeSource(PixelBatch *batch)
+{
+    for (int i = 0; i < batch->count; ++i)
+    {
+        if (batch->mask >> i & 1)
+            g_hits[batch->y[i]][batch->x[i]] = 1;
+
+        for (int c = 0; c < 4; ++c)
+            batch->color[c][i] = sourceValue(batch->x[i], batch->y[i], c);
+    }
+}
+
+static float clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static float blend(BlendMode mode, float s, float d, float a)
+{
+    switch (mode)
+    {
+    case BM_Alpha: return s * a + d * (1.0f - a);
+    case BM_Additive: return s + d;
+    case BM_Multiply: return s * d;
+    case BM_PremultipliedAlpha: return s + d * (1.0f - a);
+    default: return s;
+    }
+}
+
+static void drawQuad(Rasterizer *r)
+{
+    RasterizerVertex v[4];
+    memset(v, 0, sizeof(v));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        v[i].x = (i & 1) ? Width + 1.0f : -1.0f;
+        v[i].y = (i & 2) ? Height + 1.0f : -1.0f;
+        v[i].w = 1.0f;
+    }
+
+    Rasterizer_drawTriangle(r, &v[0], &v[1], &v[3]);
+    Rasterizer_drawTriangle(r, &v[0], &v[3], &v[2]);
+}
+
+// Covers partial blocks and spans whose length is not a multiple of four.
+static void drawTriangle(Rasterizer *r)
+{
+    RasterizerVertex v[3];
+    memset(v, 0, sizeof(v));
+
+    v[0].x = 2.3f; v[0].y = 1.7f;
+    v[1].x = 35.1f; v[1].y = 6.2f;
+    v[2].x = 9.4f; v[2].y = 27.8f;
+    for (int i = 0; i < 3; ++i)
+        v[i].w = 1.0f;
+
+    Rasterizer_drawTriangle(r, &v[0], &v[1], &v[2]);
+}
+
+static int checkRGBA8(Rasterizer *r, RenderTarget *rt, PixelShader *background, PixelShader *source,
+    RasterMode rasterMode, BlendMode blendMode, int writeMask)
+{
+    static uint8_t before[Height][Width][4];
+    static uint8_t after[Height][Width][4];
+
+    Rasterizer_setRasterMode(r, rasterMode);
+    Rasterizer_setBlendMode(r, BM_Opaque);
+    Rasterizer_setColorWriteMask(r, CWM_All);
+    Rasterizer_setPixelShader(r, background);
+    drawQuad(r);
+    RenderTarget_resolve(rt, before, Width * 4);
+
+    memset(g_hits, 0, sizeof(g_hits));
+    Rasterizer_setBlendMode(r, blendMode);
+    Rasterizer_setColorWriteMask(r, writeMask);
+    Rasterizer_setPixelShader(r, source);
+    drawTriangle(r);
+    RenderTarget_resolve(rt, after, Width * 4);
+
+    int errors = 0, hits = 0;
+    for (int y = 0; y < Height; ++y)
+        for (int x = 0; x < Width; ++x)
+        {
+            hits += g_hits[y][x];
+            float a = clamp01(sourceValue(x, y, 3));
+
+            for (int c = 0; c < 4; ++c)
+            {
+                uint8_t expected = before[y][x][c];
+                if (g_hits[y][x] && (writeMask & (1 << c)))
+                {
+                    float d = before[y][x][c] * (1.0f / 255.0f);
+                    float v = clamp01(blend(blendMode, clamp01(sourceValue(x, y, c)), d, a));
+                    expected = (uint8_t)(v * 255.0f + 0.5f);
+                }
+
+                if (after[y][x][c] != expected)
+                    errors++;
+            }
+        }
+
+    return hits ? errors : 1;
+}
+
+// Float targets are blended without clamping the color.
+static int checkR32F(Rasterizer *r, PixelShader *source)
+{
+    static float image[Height][Width];
+    RenderTarget *rt = SoftwareRenderer_createRenderTarget(RTF_R32F, Width, Height);
+    int errors = 0;
+
+    for (int mode = BM_Opaque; mode <= BM_Alpha; ++mode)
+    {
+        RenderTarget_clear(rt, 2.0f, 0.0f, 0.0f, 0.0f);
+        memset(g_hits, 0, sizeof(g_hits));
+        Rasterizer_setRasterMode(r, RM_Block);
+        Rasterizer_setBlendMode(r, (BlendMode)mode);
+        Rasterizer_setColorWriteMask(r, CWM_Red);
+        Rasterizer_setPixelShader(r, source);
+        Rasterizer_setRenderTarget(r, rt);
+        drawTriangle(r);
+        RenderTarget_resolve(rt, image, Width * 4);
+
+        for (int y = 0; y < Height; ++y)
+            for (int x = 0; x < Width; ++x)
+            {
+                float s = sourceValue(x, y, 0);
+                float expected = !g_hits[y][x] ? 2.0f :
+                    blend((BlendMode)mode, s, 2.0f, clamp01(sourceValue(x, y, 3)));
+                if (image[y][x] != expected)
+                    errors++;
+            }
+    }
+
+    printf("R32F: %d wrong pixels\n", errors);
+    return errors;
+}
+
+int main()
+{
+    static const int writeMasks[] = { CWM_All, CWM_Red | CWM_Alpha, CWM_Green | CWM_Blue };
+    int errors = 0;
+
+    SoftwareRenderer_init();
+
+    Rasterizer *r = SoftwareRenderer_createRasterizer();
+    Rasterizer_setScissorRect(r, 0, 0, Width, Height);
+
+    PixelShader *background = SoftwareRenderer_createPixelShader(false, false, 0, 0, 0);
+    PixelShader_setDrawPixelBatch(background, shadeBackground);
+    PixelShader *source = SoftwareRenderer_createPixelShader(false, false, 0, 0, 0);
+    PixelShader_setDrawPixelBatch(source, shadeSource);
+
+    RenderTarget *rt = SoftwareRenderer_createRenderTarget(RTF_RGBA8, Width, Height);
+    Rasterizer_setRenderTarget(r, rt);
+
+    for (int rasterMode = RM_Span; rasterMode <= RM_Block; ++rasterMode)
+        for (int blendMode = BM_Opaque; blendMode <= BM_PremultipliedAlpha; ++blendMode)
+            for (int m = 0; m < 3; ++m)
+            {
+                int wrong = checkRGBA8(r, rt, background, source, (RasterMode)rasterMode, (BlendMode)blendMode, writeMasks[m]);
+                if (wrong)
+                    printf("RGBA8 raster mode %d blend mode %d write mask %d: %d wrong channels\n",
+                        rasterMode, blendMode, writeMasks[m], wrong);
+                errors += wrong;
+            }
+
+    printf("RGBA8: %d wrong channels\n", errors);
+    errors += checkR32F(r, source);
+
+    SoftwareRenderer_destroy();
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Decodes hand made BC1 and BC3 blocks through the nearest sampler and
+// compares them with the colors the block format defines.
+
+#include "Renderer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { Width = 8, Height = 4 };
+
+typedef struct Rgba {
+    uint8_t r, g, b, a;
+} Rgba;
+
+// Palette of a block and how texel (x, y) picks its entry.
+typedef struct ExpectedBlock {
+    Rgba palette[4];
+    bool byRow;
+    // BC3 only: alpha of texel i is alpha[i % 8].
+    const uint8_t *alpha;
+} ExpectedBlock;
+
+// Four colors, red to blue. Texel indices go 0, 1, 2, 3 along each row.
+static const uint8_t g_bc1Opaque[8] = { 0x00, 0xf8, 0x1f, 0x00, 0xe4, 0xe4, 0xe4, 0xe4 };
+// c0 <= c1 gives three colors and transparent black. Row y uses index y.
+static const uint8_t g_bc1Transparent[8] = { 0x1f, 0x00, 0xe0, 0x07, 0x00, 0x55, 0xaa, 0xff };
+
+static const ExpectedBlock g_bc1Expected[2] = {
+    { { { 255, 0, 0, 255 }, { 0, 0, 255, 255 }, { 170, 0, 85, 255 }, { 85, 0, 170, 255 } }, false, 0 },
+    { { { 0, 0, 255, 255 }, { 0, 255, 0, 255 }, { 0, 127, 127, 255 }, { 0, 0, 0, 0 } }, true, 0 },
+};
+
+// Eight interpolated alphas, then six with explicit 0 and 255. Texel i
+// uses alpha index i % 8. The colors always use four entries in BC3, even
+// with c0 <= c1.
+static const uint8_t g_bc3Blocks[2][16] = {
+    { 0xff, 0x00, 0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa, 0x1f, 0x00, 0x00, 0xf8, 0x00, 0x55, 0xaa, 0xff },
+    { 0x00, 0xff, 0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa, 0x1f, 0x00, 0x00, 0xf8, 0x00, 0x55, 0xaa, 0xff },
+};
+
+static const uint8_t g_alpha8[8] = { 255, 0, 218, 182, 145, 109, 72, 36 };
+static const uint8_t g_alpha6[8] = { 0, 255, 51, 102, 153, 204, 0, 255 };
+
+// The alpha of the palettes is replaced by the alpha block.
+static const ExpectedBlock g_bc3Expected[2] = {
+    { { { 0, 0, 255, 0 }, { 255, 0, 0, 0 }, { 85, 0, 170, 0 }, { 170, 0, 85, 0 } }, true, g_alpha8 },
+    { { { 0, 0, 255, 0 }, { 255, 0, 0, 0 }, { 85, 0, 170, 0 }, { 170, 0, 85, 0 } }, true, g_alpha6 },
+};
+
+// Sample every texel of the two blocks of the texture, the first of which
+// is expected[first].
+static int check(const char *name, Texture *tex, const ExpectedBlock *expected, int first)
+{
+    int errors = 0;
+
+    for (int y = 0; y < Height; ++y)
+        for (int x = 0; x < Width; ++x)
+        {
+            const ExpectedBlock *block = &expected[(first + x / 4) % 2];
+            int i = y * 4 + x % 4;
+
+            Rgba e = block->palette[block->byRow ? y : x % 4];
+            if (block->alpha)
+                e.a = block->alpha[i % 8];
+
+            uint32_t texel = Texture_sample(tex, TF_Nearest, (x + 0.5f) / Width, (y + 0.5f) / Height, 0.0f);
+            Rgba t;
+            memcpy(&t, &texel, sizeof(t));
+
+            if (t.r != e.r || t.g != e.g || t.b != e.b || t.a != e.a)
+                errors++;
+        }
+
+    printf("%s: %d wrong texels\n", name, errors);
+    return errors;
+}
+
+int main()
+{
+    int errors = 0;
+    uint8_t blocks[32];
+
+    SoftwareRenderer_init();
+
+    Texture *bc1 = SoftwareRenderer_createTexture(TXF_BC1, Width, Height);
+    memcpy(blocks, g_bc1Opaque, 8);
+    memcpy(blocks + 8, g_bc1Transparent, 8);
+    Texture_setCompressedLevel(bc1, 0, blocks);
+    errors += check("BC1", bc1, g_bc1Expected, 0);
+
+    // Uploading again must not return blocks decoded before.
+    memcpy(blocks, g_bc1Transparent, 8);
+    memcpy(blocks + 8, g_bc1Opaque, 8);
+    Texture_setCompressedLevel(bc1, 0, blocks);
+    errors += check("BC1 uploaded again", bc1, g_bc1Expected, 1);
+
+    Texture *bc3 = SoftwareRenderer_createTexture(TXF_BC3, Width, Height);
+    memcpy(blocks, g_bc3Blocks, sizeof(g_bc3Blocks));
+    Texture_setCompressedLevel(bc3, 0, blocks);
+    errors += check("BC3", bc3, g_bc3Expected, 0);
+
+    SoftwareRenderer_destroy();
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Compares the SIMD coverage kernels with the scalar one and checks that
+// Coverage_classifyRect and Coverage_rectMask agree with the block masks.
+// Triangles with a far vertex check the fixed point blocks against a per
+// pixel evaluation, since their edges do not fit the 32 bit steps.
+
+#include "Coverage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { Area = 64, TriangleCount = 2000 };
+
+static const CoverageKernel g_kernels[] = { CK_SSE2, CK_AVX, CK_NEON };
+
+static uint64_t blockMask(const TriangleEquations *eqn, int x, int y, bool fixedPoint)
+{
+    return fixedPoint ? Coverage_blockMaskFixed(eqn, x, y) : Coverage_blockMask(eqn, x, y);
+}
+
+// Vertices on a quarter pixel grid so edges often pass through pixel centers.
+static bool randomTriangle(TriangleEquations *eqn)
+{
+    RasterizerVertex v[3];
+    memset(v, 0, sizeof(v));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        v[i].x = rand() % Area + (rand() % 4) * 0.25f;
+        v[i].y = rand() % Area + (rand() % 4) * 0.25f;
+        v[i].w = 1.0f;
+    }
+
+    TriangleEquations_constructEdges(eqn, &v[0], &v[1], &v[2]);
+    return eqn->area2 > 0 && TriangleEquations_constructFixed(eqn, &v[0], &v[1], &v[2]);
+}
+
+static int checkKernels(const TriangleEquations *eqn, bool fixedPoint, int *tested)
+{
+    int errors = 0;
+
+    for (int y = 0; y < Area; y += BlockSize)
+        for (int x = 0; x < Area; x += BlockSize)
+        {
+            Coverage_setKernel(CK_Scalar);
+            uint64_t expected = blockMask(eqn, x, y, fixedPoint);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                if (!Coverage_setKernel(g_kernels[k]))
+                    continue;
+                (*tested)++;
+                if (blockMask(eqn, x, y, fixedPoint) != expected)
+                    errors++;
+            }
+        }
+
+    Coverage_setKernel(CK_Scalar);
+    return errors;
+}
+
+// CC_Inside and CC_Outside must hold for every block of the rectangle.
+static int checkClassify(const TriangleEquations *eqn, bool fixedPoint)
+{
+    int errors = 0;
+
+    for (int h = BlockSize; h <= Area; h *= 2)
+        for (int w = BlockSize; w <= Area; w *= 2)
+            for (int y = 0; y + h <= Area; y += h)
+                for (int x = 0; x + w <= Area; x += w)
+                {
+                    CoverageClass cc = Coverage_classifyRect(eqn, x, y, w, h, fixedPoint);
+                    if (cc == CC_Partial)
+                        continue;
+
+                    uint64_t expected = cc == CC_Inside ? ~(uint64_t)0 : 0;
+                    for (int by = y; by < y + h; by += BlockSize)
+                        for (int bx = x; bx < x + w; bx += BlockSize)
+                            if (blockMask(eqn, bx, by, fixedPoint) != expected)
+                                errors++;
+                }
+
+    return errors;
+}
+
+static int checkRectMask(const TriangleEquations *eqn, bool fixedPoint)
+{
+    int x = rand() % (Area - BlockSize);
+    int y = rand() % (Area - BlockSize);
+    int w = rand() % BlockSize + 1;
+    int h = rand() % BlockSize + 1;
+
+    uint64_t rect = 0;
+    for (int yy = 0; yy < h; ++yy)
+        rect |= (((uint64_t)1 << w) - 1) << (yy * BlockSize);
+
+    return Coverage_rectMask(eqn, x, y, w, h, fixedPoint) != (blockMask(eqn, x, y, fixedPoint) & rect);
+}
+
+static int checkLongEdges(void)
+{
+    int errors = 0;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        RasterizerVertex v[3];
+        memset(v, 0, sizeof(v));
+        v[0].x = rand() % Area; v[0].y = rand() % Area;
+        v[1].x = 1000000.0f; v[1].y = rand() % Area + 0.25f;
+        v[2].x = rand() % Area + 0.5f; v[2].y = Area + rand() % Area;
+
+        TriangleEquations eqn;
+        if (!TriangleEquations_constructFixed(&eqn, &v[0], &v[1], &v[2]) || eqn.fixedFitsBlock)
+        {
+            errors++;
+            continue;
+        }
+
+        for (int y = 0; y < Area; y += BlockSize)
+            for (int x = 0; x < Area; x += BlockSize)
+            {
+                uint64_t expected = 0;
+                for (int yy = 0; yy < BlockSize; ++yy)
+                    for (int xx = 0; xx < BlockSize; ++xx)
+                        if (FixedEdgeEquation_evaluate(&eqn.f0, x + xx, y + yy) >= 0 &&
+                            FixedEdgeEquation_evaluate(&eqn.f1, x + xx, y + yy) >= 0 &&
+                            FixedEdgeEquation_evaluate(&eqn.f2, x + xx, y + yy) >= 0)
+                            expected |= (uint64_t)1 << (yy * BlockSize + xx);
+
+                for (int k = 0; k < 3; ++k)
+                    if (Coverage_setKernel(g_kernels[k]) && Coverage_blockMaskFixed(&eqn, x, y) != expected)
+                        errors++;
+                Coverage_setKernel(CK_Scalar);
+                if (Coverage_blockMaskFixed(&eqn, x, y) != expected)
+                    errors++;
+            }
+    }
+
+    return errors;
+}
+
+int main()
+{
+    int kernelErrors = 0, classifyErrors = 0, rectErrors = 0, tested = 0;
+
+    Coverage_init();
+    srand(1);
+
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        TriangleEquations eqn;
+        if (!randomTriangle(&eqn))
+            continue;
+
+        for (int fixedPoint = 0; fixedPoint < 2; ++fixedPoint)
+        {
+            kernelErrors += checkKernels(&eqn, fixedPoint, &tested);
+            classifyErrors += checkClassify(&eqn, fixedPoint);
+            rectErrors += checkRectMask(&eqn, fixedPoint);
+        }
+    }
+
+    int longEdgeErrors = checkLongEdges();
+
+    printf("kernels: %d of %d blocks differ\n", kernelErrors, tested);
+    printf("classifyRect: %d wrong blocks\n", classifyErrors);
+    printf("rectMask: %d wrong masks\n", rectErrors);
+    printf("long edges: %d wrong blocks\n", longEdgeErrors);
+    return kernelErrors || classifyErrors || rectErrors || longEdgeErrors ? 1 : 0;
+}
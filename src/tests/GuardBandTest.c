@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Draws triangles with one vertex far outside the viewport once with the
+// guard band and once clipped, and compares the covered pixels. The guard
+// band is limited to the fixed point range, so the far vertices are clipped
+// against its planes instead of reaching the rasterizer.
+
+#include "Renderer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { Size = 64 };
+
+static int g_covered[Size][Size];
+
+static void drawPixel(const PixelData *p)
+{
+    g_covered[p->y][p->x]++;
+}
+
+static void processVertex(VertexShaderInput in, VertexShaderOutput *out)
+{
+    const float *data = (const float*)in[0];
+    out->x = data[0];
+    out->y = data[1];
+    out->z = 0.0f;
+    out->w = 1.0f;
+}
+
+static int draw(VertexProcessor *vp, float guardBand, const float *positions)
+{
+    int indices[3] = { 0, 1, 2 };
+
+    memset(g_covered, 0, sizeof(g_covered));
+    VertexProcessor_setGuardBand(vp, guardBand, guardBand);
+    VertexProcessor_setVertexAttribPointer(vp, 0, 2 * sizeof(float), positions);
+    VertexProcessor_drawElements(vp, DM_Triangle, 3, indices);
+
+    int count = 0;
+    for (int y = 0; y < Size; ++y)
+        for (int x = 0; x < Size; ++x)
+            count += g_covered[y][x];
+    return count;
+}
+
+int main()
+{
+    static const float farX[] = { 20000.0f, 200000.0f };
+    static int clipped[Size][Size];
+    int errors = 0;
+
+    SoftwareRenderer_init();
+
+    Rasterizer *r = SoftwareRenderer_createRasterizer();
+    PixelShader *ps = SoftwareRenderer_createPixelShader(false, false, 0, 0, drawPixel);
+    VertexShader *vs = SoftwareRenderer_createVertexShader(1, processVertex);
+    VertexProcessor *vp = SoftwareRenderer_createVertexProcessor(r);
+
+    Rasterizer_setPixelShader(r, ps);
+    Rasterizer_setFixedPoint(r, true);
+    Rasterizer_setRasterMode(r, RM_Block);
+    Rasterizer_setScissorRect(r, 0, 0, Size, Size);
+    VertexProcessor_setViewport(vp, 0, 0, Size, Size);
+    VertexProcessor_setCullMode(vp, CM_None);
+    VertexProcessor_setVertexShader(vp, vs);
+
+    for (int i = 0; i < (int)(sizeof(farX) / sizeof(farX[0])); ++i)
+    {
+        float positions[6] = { -0.9f, -0.9f, farX[i], 0.1f, -0.9f, 0.8f };
+
+        int clippedCount = draw(vp, 1.0f, positions);
+        memcpy(clipped, g_covered, sizeof(clipped));
+        int guardBandCount = draw(vp, 1e6f, positions);
+
+        // Clipping against different planes may move the edges by a fraction
+        // of a pixel, so allow a few pixels along the clipped edges.
+        int wrong = 0;
+        for (int y = 0; y < Size; ++y)
+            for (int x = 0; x < Size; ++x)
+                if (g_covered[y][x] != clipped[y][x])
+                    wrong++;
+
+        printf("x = %g: %d pixels clipped, %d with guard band, %d differ\n", farX[i], clippedCount, guardBandCount, wrong);
+        if (clippedCount == 0 || wrong > Size / 8)
+            errors++;
+    }
+
+    SoftwareRenderer_destroy();
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Checks that JobSystem_parallelFor visits every index exactly once for
+// several thread counts, sizes and grains, and that its wait leaves queued
+// background jobs to the workers.
+
+#include "JobSystem.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { MaxCount = 100000 };
+
+static volatile long g_visits[MaxCount];
+
+static void countVisits(void *data, int begin, int end)
+{
+    (void)data;
+    for (int i = begin; i < end; ++i)
+        Atomic_add(&g_visits[i], 1);
+}
+
+static THREAD_LOCAL int t_inParallelFor;
+static volatile long g_backgroundInParallelFor;
+static JobCounter g_backgroundCounter;
+
+static void backgroundJob(void *data, int begin, int end)
+{
+    (void)data;
+    (void)begin;
+    (void)end;
+    if (t_inParallelFor)
+        Atomic_add(&g_backgroundInParallelFor, 1);
+}
+
+// Queues background jobs above the remaining jobs of the parallelFor.
+static void submitBackgroundJobs(void *data, int begin, int end)
+{
+    countVisits(data, begin, end);
+    JobSystem_submitBackground(&g_backgroundCounter, backgroundJob, 0, 0, 1);
+}
+
+static int checkBackgroundJobs(void)
+{
+    g_backgroundCounter.pending = 0;
+    g_backgroundInParallelFor = 0;
+
+    t_inParallelFor = 1;
+    JobSystem_parallelFor(MaxCount, 16, submitBackgroundJobs, 0);
+    t_inParallelFor = 0;
+
+    // Waiting on their own counter may run them.
+    JobSystem_wait(&g_backgroundCounter);
+    return (int)g_backgroundInParallelFor;
+}
+
+int main()
+{
+    static const int threadCounts[] = { 1, 2, 4, 0 };
+    static const int counts[] = { 0, 1, 7, 1000, MaxCount };
+    static const int grains[] = { 1, 16, 1000 };
+    int errors = 0, backgroundErrors = 0;
+
+    for (int t = 0; t < 4; ++t)
+    {
+        JobSystem_init(threadCounts[t]);
+
+        for (int c = 0; c < 5; ++c)
+            for (int g = 0; g < 3; ++g)
+            {
+                memset((void*)g_visits, 0, sizeof(g_visits));
+                JobSystem_parallelFor(counts[c], grains[g], countVisits, 0);
+
+                int wrong = 0;
+                for (int i = 0; i < MaxCount; ++i)
+                    if (g_visits[i] != (i < counts[c] ? 1 : 0))
+                        wrong++;
+
+                if (wrong)
+                    printf("threads %d count %d grain %d: %d wrong indices\n",
+                        JobSystem_threadCount(), counts[c], grains[g], wrong);
+                errors += wrong;
+            }
+
+        if (JobSystem_threadCount() > 1)
+            backgroundErrors += checkBackgroundJobs();
+
+        JobSystem_shutdown();
+    }
+
+    printf("parallelFor: %d wrong indices\n", errors);
+    printf("background jobs run by parallelFor: %d\n", backgroundErrors);
+    return errors || backgroundErrors ? 1 : 0;
+}
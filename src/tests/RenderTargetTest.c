@@ -0,0 +1,135 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Stores batch shader results into render targets whose size is not a
+// multiple of the block size and checks the resolved images.
+
+#include "Renderer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { Width = 37, Height = 29 };
+
+static void shadeBatch(PixelBatch *batch)
+{
+    for (int i = 0; i < batch->count; ++i)
+    {
+        batch->color[0][i] = batch->x[i] / 255.0f;
+        batch->color[1][i] = batch->y[i] / 255.0f;
+        batch->color[2][i] = 1.0f;
+        batch->color[3][i] = 1.0f;
+    }
+}
+
+// Two triangles covering the whole target at depth z.
+static void drawQuad(Rasterizer *r, float z)
+{
+    RasterizerVertex v[4];
+    memset(v, 0, sizeof(v));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        v[i].x = (i & 1) ? Width + 1.0f : -1.0f;
+        v[i].y = (i & 2) ? Height + 1.0f : -1.0f;
+        v[i].z = z;
+        v[i].w = 1.0f;
+    }
+
+    Rasterizer_drawTriangle(r, &v[0], &v[1], &v[3]);
+    Rasterizer_drawTriangle(r, &v[0], &v[3], &v[2]);
+}
+
+static int checkColor(Rasterizer *r, PixelShader *ps)
+{
+    static uint8_t image[Height][Width][4];
+    RenderTarget *rt = SoftwareRenderer_createRenderTarget(RTF_RGBA8, Width, Height);
+    int errors = 0;
+
+    for (int mode = RM_Span; mode <= RM_Tiled; ++mode)
+    {
+        RenderTarget_clear(rt, 0.0f, 0.0f, 0.0f, 0.0f);
+        Rasterizer_setRasterMode(r, (RasterMode)mode);
+        Rasterizer_setPixelShader(r, ps);
+        Rasterizer_setRenderTarget(r, rt);
+        drawQuad(r, 0.5f);
+        RenderTarget_resolve(rt, image, Width * 4);
+
+        for (int y = 0; y < Height; ++y)
+            for (int x = 0; x < Width; ++x)
+                if (image[y][x][0] != x || image[y][x][1] != y || image[y][x][2] != 255 || image[y][x][3] != 255)
+                    errors++;
+    }
+
+    Rasterizer_setRenderTarget(r, 0);
+    printf("RGBA8: %d wrong pixels\n", errors);
+    return errors;
+}
+
+// D32F targets store z, but only for shaders that interpolate it.
+static int checkDepth(Rasterizer *r, PixelShader *ps, float expected)
+{
+    static float image[Height][Width];
+    RenderTarget *rt = SoftwareRenderer_createRenderTarget(RTF_D32F, Width, Height);
+    int errors = 0;
+
+    RenderTarget_clear(rt, 1.0f, 0.0f, 0.0f, 0.0f);
+    Rasterizer_setRasterMode(r, RM_Block);
+    Rasterizer_setPixelShader(r, ps);
+    Rasterizer_setRenderTarget(r, rt);
+    drawQuad(r, 0.25f);
+    RenderTarget_resolve(rt, image, Width * 4);
+
+    for (int y = 0; y < Height; ++y)
+        for (int x = 0; x < Width; ++x)
+            if (image[y][x] != expected)
+                errors++;
+
+    Rasterizer_setRenderTarget(r, 0);
+    printf("D32F %s z: %d wrong pixels\n", expected == 1.0f ? "without" : "with", errors);
+    return errors;
+}
+
+int main()
+{
+    int errors = 0;
+
+    SoftwareRenderer_init();
+
+    Rasterizer *r = SoftwareRenderer_createRasterizer();
+    Rasterizer_setScissorRect(r, 0, 0, Width, Height);
+
+    PixelShader *color = SoftwareRenderer_createPixelShader(false, false, 0, 0, 0);
+    PixelShader_setDrawPixelBatch(color, shadeBatch);
+    errors += checkColor(r, color);
+
+    PixelShader *depth = SoftwareRenderer_createPixelShader(true, false, 0, 0, 0);
+    PixelShader_setDrawPixelBatch(depth, shadeBatch);
+    errors += checkDepth(r, depth, 0.25f);
+    errors += checkDepth(r, color, 1.0f);
+
+    SoftwareRenderer_destroy();
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Renders the same scene directly and through the visibility buffer mode
+// and compares the images. The scissor rect grows while recording, and
+// lines and points are drawn last so both paths put them on top.
+
+#include "Renderer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+enum { Width = 100, Height = 80, TriangleCount = 40 };
+
+static float g_color[Height][Width];
+static int g_triangleShades[Height][Width];
+static int g_shades[Height][Width];
+
+static RasterizerVertex g_vertices[TriangleCount * 3];
+
+static void drawPixel(const PixelData *p)
+{
+    g_color[p->y][p->x] = p->avar[0];
+    g_shades[p->y][p->x]++;
+    if (p->equations)
+        g_triangleShades[p->y][p->x]++;
+}
+
+static unsigned g_seed = 1;
+
+static float randomFloat(float lo, float hi)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return lo + (hi - lo) * ((g_seed >> 8) & 0xffff) / 65535.0f;
+}
+
+// Overlapping front-facing triangles at different depths.
+static void buildScene(void)
+{
+    for (int t = 0; t < TriangleCount; ++t)
+    {
+        RasterizerVertex *v = &g_vertices[t * 3];
+        memset(v, 0, 3 * sizeof(*v));
+
+        for (int k = 0; k < 3; ++k)
+        {
+            v[k].x = randomFloat(-10.0f, Width + 10.0f);
+            v[k].y = randomFloat(-10.0f, Height + 10.0f);
+            v[k].z = randomFloat(0.1f, 0.9f);
+            v[k].w = 1.0f;
+            v[k].avar[0] = t + 0.25f * k;
+        }
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if (area < 0)
+        {
+            RasterizerVertex tmp = v[1];
+            v[1] = v[2];
+            v[2] = tmp;
+        }
+    }
+}
+
+static void drawScene(Rasterizer *r)
+{
+    Rasterizer_clearDepth(r, 1.0f);
+    memset(g_color, 0, sizeof(g_color));
+    memset(g_triangleShades, 0, sizeof(g_triangleShades));
+    memset(g_shades, 0, sizeof(g_shades));
+
+    // The first half only covers the top left quarter.
+    Rasterizer_setScissorRect(r, 0, 0, Width / 2, Height / 2);
+    for (int t = 0; t < TriangleCount; ++t)
+    {
+        if (t == TriangleCount / 2)
+            Rasterizer_setScissorRect(r, 0, 0, Width, Height);
+        Rasterizer_drawTriangle(r, &g_vertices[t * 3], &g_vertices[t * 3 + 1], &g_vertices[t * 3 + 2]);
+    }
+
+    RasterizerVertex v[2];
+    memset(v, 0, sizeof(v));
+    v[0].x = 3.5f; v[0].y = 70.5f; v[0].w = 1.0f; v[0].avar[0] = 100.0f;
+    v[1].x = 96.5f; v[1].y = 5.5f; v[1].w = 1.0f; v[1].avar[0] = 200.0f;
+    Rasterizer_drawLine(r, &v[0], &v[1]);
+
+    v[0].x = 50.5f; v[0].y = 40.5f; v[0].avar[0] = 300.0f;
+    Rasterizer_drawPoint(r, &v[0]);
+}
+
+int main()
+{
+    static float reference[Height][Width];
+    static int referenceShades[Height][Width];
+    int errors = 0;
+
+    SoftwareRenderer_init();
+
+    Rasterizer *r = SoftwareRenderer_createRasterizer();
+    PixelShader *ps = SoftwareRenderer_createPixelShader(false, false, 1, 0, drawPixel);
+    Rasterizer_setPixelShader(r, ps);
+    Rasterizer_setDepthTest(r, true);
+    buildScene();
+
+    for (int mode = RM_Span; mode <= RM_Tiled; ++mode)
+    {
+        Rasterizer_setRasterMode(r, (RasterMode)mode);
+
+        drawScene(r);
+        memcpy(reference, g_color, sizeof(reference));
+        memcpy(referenceShades, g_shades, sizeof(referenceShades));
+
+        Rasterizer_setVisibilityMode(r, true);
+        drawScene(r);
+
+        int early = 0;
+        for (int y = 0; y < Height; ++y)
+            for (int x = 0; x < Width; ++x)
+                early += g_shades[y][x];
+
+        Rasterizer_resolveVisibility(r);
+        Rasterizer_setVisibilityMode(r, false);
+
+        int wrong = 0, shadedTwice = 0;
+        for (int y = 0; y < Height; ++y)
+            for (int x = 0; x < Width; ++x)
+            {
+                if ((g_shades[y][x] > 0) != (referenceShades[y][x] > 0) || fabsf(g_color[y][x] - reference[y][x]) > 1e-3f)
+                    wrong++;
+                if (g_triangleShades[y][x] > 1)
+                    shadedTwice++;
+            }
+
+        printf("raster mode %d: %d wrong pixels, %d shaded twice, %d shaded before resolving\n",
+            mode, wrong, shadedTwice, early);
+        errors += wrong + shadedTwice + early;
+    }
+
+    SoftwareRenderer_destroy();
+    return errors ? 1 : 0;
+}
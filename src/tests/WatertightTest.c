@@ -0,0 +1,155 @@
+/*
+MIT License
+
+Copyright (c) 2017 trenki2
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Draws a mesh of large and small triangles sharing edges in every raster
+// mode and checks that each pixel inside it is covered exactly once.
+
+#include "Renderer.h"
+#include "Rasterizer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum { Width = 256, Height = 192 };
+
+// Small and large cells. Several vertical grid lines pass through pixel
+// centers so that the fill rule decides about the pixels on the shared edges.
+// No vertex is on a pixel center, where only fixed point breaks ties exactly.
+static const float g_columns[] = { 10.25f, 12.5f, 13.5f, 60.5f, 62.1f, 130.3f, 131.5f, 133.2f, 200.5f, 240.6f };
+static const float g_rows[] = { 8.3f, 9.7f, 11.2f, 70.6f, 72.4f, 150.8f, 152.1f, 180.4f };
+
+enum {
+    Columns = sizeof(g_columns) / sizeof(g_columns[0]),
+    Rows = sizeof(g_rows) / sizeof(g_rows[0])
+};
+
+static int g_hits[Height][Width];
+static RasterizerVertex g_vertices[Columns * Rows];
+static int g_indices[(Columns - 1) * (Rows - 1) * 6];
+static int g_indexCount;
+
+static void drawPixel(const PixelData *p)
+{
+    g_hits[p->y][p->x]++;
+}
+
+static void addTriangle(int a, int b, int c)
+{
+    const RasterizerVertex *v0 = &g_vertices[a], *v1 = &g_vertices[b], *v2 = &g_vertices[c];
+    float area = (v1->x - v0->x) * (v2->y - v0->y) - (v1->y - v0->y) * (v2->x - v0->x);
+
+    g_indices[g_indexCount++] = a;
+    g_indices[g_indexCount++] = area > 0 ? b : c;
+    g_indices[g_indexCount++] = area > 0 ? c : b;
+}
+
+// Grid with alternating diagonals.
+static void buildMesh(void)
+{
+    for (int y = 0; y < Rows; ++y)
+        for (int x = 0; x < Columns; ++x)
+        {
+            RasterizerVertex *v = &g_vertices[y * Columns + x];
+            memset(v, 0, sizeof(*v));
+            v->x = g_columns[x];
+            v->y = g_rows[y];
+            v->z = 0.5f;
+            v->w = 1.0f;
+        }
+
+    for (int y = 0; y < Rows - 1; ++y)
+        for (int x = 0; x < Columns - 1; ++x)
+        {
+            int i = y * Columns + x;
+
+            if ((x + y) & 1)
+            {
+                addTriangle(i, i + 1, i + Columns + 1);
+                addTriangle(i, i + Columns + 1, i + Columns);
+            }
+            else
+            {
+                addTriangle(i, i + 1, i + Columns);
+                addTriangle(i + 1, i + Columns + 1, i + Columns);
+            }
+        }
+}
+
+static int check(const char *name)
+{
+    int missed = 0, twice = 0, outside = 0;
+
+    for (int y = 0; y < Height; ++y)
+        for (int x = 0; x < Width; ++x)
+        {
+            float cx = x + 0.5f, cy = y + 0.5f;
+            bool inside = cx > g_columns[0] && cx < g_columns[Columns - 1] && cy > g_rows[0] && cy < g_rows[Rows - 1];
+
+            if (inside && g_hits[y][x] == 0) missed++;
+            if (g_hits[y][x] > 1) twice++;
+            if (!inside && g_hits[y][x]) outside++;
+        }
+
+    printf("%s: missed %d, covered twice %d, outside %d\n", name, missed, twice, outside);
+    return missed + twice + outside;
+}
+
+int main()
+{
+    static const char *modeNames[] = { "span", "block", "adaptive", "tiled" };
+    int failures = 0;
+
+    SoftwareRenderer_init();
+
+    Rasterizer *r = SoftwareRenderer_createRasterizer();
+    PixelShader *ps = SoftwareRenderer_createPixelShader(false, false, 0, 0, drawPixel);
+    Rasterizer_setScissorRect(r, 0, 0, Width, Height);
+    Rasterizer_setPixelShader(r, ps);
+
+    buildMesh();
+
+    for (int mode = RM_Span; mode <= RM_Tiled; ++mode)
+        for (int fixedPoint = 0; fixedPoint < 2; ++fixedPoint)
+        {
+            // Span mode has no fixed point variant and adaptive mode mixes
+            // the span and block fill rules without it.
+            if ((mode == RM_Span && fixedPoint) || (mode == RM_Adaptive && !fixedPoint))
+                continue;
+
+            char name[64];
+            sprintf(name, "%s%s", modeNames[mode], fixedPoint ? " fixed point" : "");
+
+            memset(g_hits, 0, sizeof(g_hits));
+            Rasterizer_setRasterMode(r, (RasterMode)mode);
+            Rasterizer_setFixedPoint(r, fixedPoint != 0);
+            Rasterizer_drawTriangleList(r, g_vertices, g_indices, g_indexCount);
+
+            if (check(name))
+                failures++;
+        }
+
+    SoftwareRenderer_destroy();
+    return failures ? 1 : 0;
+}